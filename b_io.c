@@ -16,65 +16,218 @@
 #include <unistd.h>
 #include <stdlib.h>			// for malloc
 #include <string.h>			// for memcpy
+#include <limits.h>			// for INT_MAX
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include "b_io.h"
+#include "blockMap.h"
+#include "lzCodec.h"
+#include "refTable.h"
+#include "snapshot.h"
+#include "checksum.h"
+#include "segment.h"
 
 
-#define MAXFCBS 20
+#define FCB_CHUNK_SIZE 64  //FCBs added to the table at a time
 #define B_CHUNK_SIZE 512
+#define DEDUP_RUN_MAX 64  //Most blocks hashed ahead when writing a run
+#define COPY_RANGE_SIZE (1024 * 1024) //Most bytes b_copy_range moves at once
+#define VIEW_MAX_SIZE (1024 * 1024)   //Most bytes b_read_view reads at once
 
+// A logical block of a file is one cluster (clusterSize bytes), or one
+// chunk if the file is compressed, which is the unit the file's block map
+// and our buffer work in
 typedef struct b_fcb {
   /** TODO add all the information you need in the file control block **/
   char* buf;				       //holds the open file buffer
   int index;				       //holds the current position in the buffer
   int buflen;				       //holds how many valid bytes are in the buffer
 
-  int location;   		    //holds the file location(block number) in the volume, 
-                          //so we can write to that location
+  int bufBlock;           //holds the logical block of the file that is in
+                          //the buffer (-1 if the buffer holds no block)
+  int bufDirty;           //1 if the buffer has changes not yet written
 
   off_t offset;    		    //holds the current position in file
 
-  int fileSize;			      //holds the size of the opened file
-  char flags[5];  		    //at max we can have 4 flags set
+  off_t fileSize;			    //holds the size of the opened file
+  int unitSize;           //holds the number of bytes in each logical block
+  char flags[6];  		    //at max we can have 5 flags set
+  int written;            //1 if the file was written to since it was opened
+
+  blockMap* map;          //maps each logical block of the file to the
+                          //volume block that holds it
+
+  int isInline;           //1 if the file is small enough that its data is
+                          //kept in its directory entry instead of a block
 
   hashTable* directory; 	//points to the parent directory that contains
                           //the opened file
 
   dirEntry* entry;  		  //points to the directory entry associated
                           //with opened file
+
+  char* view;             //holds the data lent out by b_read_view
+  int viewSize;           //holds the number of bytes view has room for
+  int viewFirst;          //holds the first logical block in view (-1 if
+                          //view holds no blocks)
+  int viewUnits;          //holds the number of logical blocks in view
+  int viewHeld;           //1 if the data in view is lent out
+
+  b_io_fd nextFree;       //the next free FCB while this one is free
 } b_fcb;
 
-b_fcb fcbArray[MAXFCBS];
+// The FCBs are kept in chunks of FCB_CHUNK_SIZE that are never moved, so
+// a pointer to an FCB stays good as the table grows. Free FCBs are linked
+// through nextFree, so getting one never searches the table. Each FCB has
+// a lock of its own next to it, which is not copied along with the FCB.
+typedef struct fcbChunk {
+  b_fcb fcbs[FCB_CHUNK_SIZE];
+  pthread_rwlock_t locks[FCB_CHUNK_SIZE];
+} fcbChunk;
+
+fcbChunk** fcbChunks = NULL;
+int numFcbChunks = 0;
+int numFcbs = 0;          //Number of FCBs in all the chunks
+b_io_fd freeFcb = -1;     //First free FCB (-1 = none)
+
+// Held while the table of chunks and the free list are used, so that
+// threads opening files at once get different FCBs
+pthread_mutex_t fcbTableLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Calls that only read the volume (b_read, b_pread, and b_seek) hold the
+// volume lock shared, so any number of them run at once, and every other
+// call holds it alone. A thread that holds it alone can take it again,
+// since calls like b_truncate are made of other calls. Calls holding it
+// shared also hold the lock of their FCB, shared for b_pread and alone
+// for the calls that move the file's offset or use its buffer.
+pthread_rwlock_t volumeLock = PTHREAD_RWLOCK_INITIALIZER;
+__thread int volumeDepth = 0;   //Times this thread took volumeLock alone
+
+// A file being moved by the defragmenter while it does not hold the
+// volume lock, and whether it has been opened since (both only used while
+// the volume lock is held alone)
+int watchedDir = -1;      //Location of the file's directory (-1 = none)
+char watchedName[20];
+int watchedOpened = 0;
 
 int startup = 0;	//Indicates that this has not been initialized
 
 
 //Method to initialize our file system
 void b_init() {
-  //init fcbArray to all free
-  for (int i = 0; i < MAXFCBS; i++) {
-    fcbArray[i].buf = NULL; //indicates a free fcbArray
-  }
-
+  //The table starts out empty and grows as files are opened
   startup = 1;
 }
 
-//Method to get a free FCB element
+//Returns the chunk that holds the FCB of fd, which must be less than
+//numFcbs
+fcbChunk* chunkOf(b_io_fd fd) {
+  pthread_mutex_lock(&fcbTableLock);
+  fcbChunk* chunk = fcbChunks[fd / FCB_CHUNK_SIZE];
+  pthread_mutex_unlock(&fcbTableLock);
+  return chunk;
+}
+
+//Returns the FCB of fd, which must be less than numFcbs
+b_fcb* fcbAt(b_io_fd fd) {
+  return &chunkOf(fd)->fcbs[fd % FCB_CHUNK_SIZE];
+}
+
+//Adds a chunk of free FCBs to the table, which fcbTableLock must be held for
+void addFcbChunk() {
+  fcbChunks = realloc(fcbChunks, (numFcbChunks + 1) * sizeof(fcbChunk*));
+  fcbChunk* chunk = calloc(1, sizeof(fcbChunk));
+  if (!fcbChunks || !chunk) {
+    mallocFailed();
+  }
+  fcbChunks[numFcbChunks++] = chunk;
+
+  //The new FCBs go on the free list lowest first
+  for (int i = FCB_CHUNK_SIZE - 1; i >= 0; i--) {
+    pthread_rwlock_init(&chunk->locks[i], NULL);
+    chunk->fcbs[i].buf = NULL;  //indicates a free FCB
+    chunk->fcbs[i].nextFree = freeFcb;
+    freeFcb = numFcbs + i;
+  }
+  numFcbs += FCB_CHUNK_SIZE;
+}
+
+//Method to get a free FCB element, growing the table if every one is
+//in use
 b_io_fd b_getFCB() {
-  for (int i = 0; i < MAXFCBS; i++) {
-    if (fcbArray[i].buf == NULL) {
-      return i;		//Not thread safe (But do not worry about it for this assignment)
-    }
+  pthread_mutex_lock(&fcbTableLock);
+  if (freeFcb < 0) {
+    addFcbChunk();
   }
-  return (-1);  //all in use
+
+  b_io_fd fd = freeFcb;
+  freeFcb = fcbChunks[fd / FCB_CHUNK_SIZE]->fcbs[fd % FCB_CHUNK_SIZE].nextFree;
+  pthread_mutex_unlock(&fcbTableLock);
+  return fd;
 }
 
-// Interface to open a buffered file
-// Modification of interface for this assignment, flags match the Linux flags for open
-// O_RDONLY, O_WRONLY, or O_RDWR
-b_io_fd b_open(char* filename, int flags) {
+//Puts an FCB that is no longer in use back on the free list
+void b_freeFCB(b_io_fd fd) {
+  pthread_mutex_lock(&fcbTableLock);
+  fcbChunks[fd / FCB_CHUNK_SIZE]->fcbs[fd % FCB_CHUNK_SIZE].nextFree = freeFcb;
+  freeFcb = fd;
+  pthread_mutex_unlock(&fcbTableLock);
+}
+
+//Takes the volume lock, alone if change is 1 and shared otherwise
+void lockVolume(int change) {
+  if (volumeDepth > 0) {
+    volumeDepth++;    //this thread already holds it alone
+    return;
+  }
+
+  if (change) {
+    pthread_rwlock_wrlock(&volumeLock);
+    volumeDepth = 1;
+  } else {
+    pthread_rwlock_rdlock(&volumeLock);
+  }
+}
+
+//Gives back the volume lock taken by lockVolume
+void unlockVolume() {
+  if (volumeDepth > 1) {
+    volumeDepth--;
+    return;
+  }
+
+  volumeDepth = 0;
+  pthread_rwlock_unlock(&volumeLock);
+}
+
+//Takes the lock of the FCB of fd, alone if change is 1 and shared
+//otherwise. A thread holding the volume lock alone needs no FCB locks.
+void lockFile(b_io_fd fd, int change) {
+  if (volumeDepth > 0) {
+    return;
+  }
+
+  pthread_rwlock_t* lock = &chunkOf(fd)->locks[fd % FCB_CHUNK_SIZE];
+  if (change) {
+    pthread_rwlock_wrlock(lock);
+  } else {
+    pthread_rwlock_rdlock(lock);
+  }
+}
+
+//Gives back the lock of the FCB of fd taken by lockFile
+void unlockFile(b_io_fd fd) {
+  if (volumeDepth > 0) {
+    return;
+  }
+
+  pthread_rwlock_unlock(&chunkOf(fd)->locks[fd % FCB_CHUNK_SIZE]);
+}
+
+// Opens a file for b_open, which holds the volume lock
+b_io_fd openFile(char* filename, int flags) {
   b_io_fd returnFd;
 
   //*** TODO ***:  Modify to save or set any information needed
@@ -83,28 +236,23 @@ b_io_fd b_open(char* filename, int flags) {
 
   if (startup == 0) b_init();  //Initialize our system
 
-  returnFd = b_getFCB();	// get our own file descriptor
-
-  if (returnFd == -1) { // check for error - all used FCB's
-    printf("Error: limit of number of open files exceeded\n");
-    return -1;
-  }
-
-  // Initialize a file control block for the file
-  b_fcb fcb = fcbArray[returnFd];
+  // Initialize a file control block for the file, which only gets its
+  // file descriptor once the file is open
+  b_fcb fcb = { 0 };
 
   //****************Permissions*********************//
 
   // 0th index represents the read flag, and 1st index
   // represents the write flag, 2nd represents the O_CREAT
-  // flag, and 3rd represents the O_TRUNC flag
+  // flag, 3rd represents the O_TRUNC flag, and 4th represents
+  // the O_APPEND flag
 
   // Initialy we set all flags to 0
-  for (int i = 0; i < 4; i++) {
+  for (int i = 0; i < 5; i++) {
     fcb.flags[i] = 0 + '0';
   }
 
-  fcb.flags[4] = '\0';
+  fcb.flags[5] = '\0';
 
   // If read and write permissions are set we can assume
   // that we can both read and write to a file, and that
@@ -132,6 +280,10 @@ b_io_fd b_open(char* filename, int flags) {
     fcb.flags[3] = 1 + '0';
   }
 
+  if (flags & O_APPEND) {
+    fcb.flags[4] = 1 + '0';
+  }
+
   //***************End of Permissions*******************//
 
 
@@ -153,22 +305,41 @@ b_io_fd b_open(char* filename, int flags) {
     return -1;
   }
 
+  // A snapshot is read-only, so its files can only be opened for reading
+  if (((fcb.flags[1] - '0') || (fcb.flags[2] - '0') || (fcb.flags[3] - '0')) &&
+    inSnapshot(parentDir->location)) {
+    printf("ERROR: Snapshots are read-only\n");
+    clean(parentDir);
+    return -1;
+  }
+
   dirEntry* dirEntry = getEntry(pathParts->childName, parentDir);
 
   // If the last component doesn't exist:
   if (!(fs_isFile(filename) || fs_isDir(filename))) {
     // If the O_CREAT flag is set we can create that file
     if (fcb.flags[2] - '0') {
-      int freeBlock = getFreeBlockNum(1);
-      // Check if the freeBlock returned is valid or not
-      if (freeBlock < 0) {
-        return -1;
+      // A new file has no blocks yet, they are given to it as
+      // data is written
+      dirEntry = dirEntryInit(pathParts->childName, 0, 0,
+        0, time(0), time(0));
+      dirEntry->compressed = compressFiles || (flags & O_COMPRESS);
+
+      // If inline file data has used up the directory's space, move
+      // some of it out into blocks to make room for the new entry
+      if (!hasRoomFor(dirEntry->filename, dirEntry, parentDir)) {
+        int location = parentDir->location;
+        hashTable* dir = readTableData(location);
+        makeRoomInDir(dir, dirRecordSize(dirEntry));
+        writeTableData(dir, location);
+
+        clean(parentDir);
+        parentDir = readTableData(location);
       }
 
-      dirEntry = dirEntryInit(pathParts->childName, 0, freeBlock,
-        0, time(0), time(0));
-      setBlocksAsAllocated(dirEntry->location, 1);
-      setEntry(dirEntry->filename, dirEntry, parentDir);
+      if (!setEntry(dirEntry->filename, dirEntry, parentDir)) {
+        return -1;
+      }
     }
     // else return error
     else {
@@ -185,72 +356,31 @@ b_io_fd b_open(char* filename, int flags) {
     }
     if (fcb.flags[3] - '0') {
       dirEntry->fileSize = 0;
+      dirEntry->inlineLen = 0;
 
-      char* buffer = malloc(blockSize);
-      if (!buffer) {
-        mallocFailed();
-      }
-      LBAread(buffer, 1, dirEntry->location);
-
-      char blockChars[6];
-
-      for (int j = 0; j < 5; j++) {
-        blockChars[j] = buffer[j];
-      }
-      blockChars[5] = '\0';
-
-      // Convert the characters representing block number to
-      // an integer
-      const char* constBlockNumbs = blockChars;
-      int nextBlock = atoi(constBlockNumbs);
-
-      free(buffer);
-      buffer = NULL;
-
-      // We want to overrite the existing file's first block with
-      // empty buffer
-      buffer = calloc(blockSize, 1);
-      LBAwrite(buffer, 1, dirEntry->location);
-
-      free(buffer);
-      buffer = NULL;
-
-      // In the following loop we iterate through each block associated with
-      // the file and set it as free, as it will allow those blocks to be
-      // overwritten
-      while (nextBlock) {
-        setBlocksAsFree(nextBlock, 1);
-
-        buffer = calloc(blockSize, 1);
-        if (!buffer) {
-          mallocFailed();
-        }
-
-        LBAread(buffer, 1, nextBlock);
-
-        char blockChars[6];
-
-        for (int j = 0; j < 5; j++) {
-          blockChars[j] = buffer[j];
-        }
-        blockChars[5] = '\0';
-
-        // Convert the characters representing block number to
-        // an integer
-        const char* constBlockNumbs = blockChars;
-        nextBlock = atoi(constBlockNumbs);
-
-        free(buffer);
-        buffer = NULL;
-      }
+      // We free every block associated with the file, as it will
+      // allow those blocks to be overwritten
+      blockMap* map = mapLoadEntry(dirEntry);
+      mapRelease(map);
+      mapFree(map);
+      map = NULL;
 
+      dirEntry->location = 0;
+      dirEntry->tailMap = 0;
     }
 
   }
 
-  // Initially we malloc memory equivalent to 1 block we can malloc 
-  // more memory as we need it
-  fcb.buf = calloc(sizeof(char) * blockSize, 1);
+  // A compressed file is read and written a chunk at a time, since that
+  // is the unit it is compressed in
+  fcb.unitSize = clusterSize;
+  if (dirEntry->compressed && COMPRESS_CHUNK_SIZE > clusterSize) {
+    fcb.unitSize = COMPRESS_CHUNK_SIZE;
+  }
+
+  // Initially we malloc memory equivalent to 1 logical block we can
+  // malloc more memory as we need it
+  fcb.buf = calloc(sizeof(char) * fcb.unitSize, 1);
   if (!fcb.buf) {
     mallocFailed();
   }
@@ -258,10 +388,13 @@ b_io_fd b_open(char* filename, int flags) {
   // To represent number of valid bytes in our buffer
   fcb.buflen = 0;
 
-  // To represent the current position in the buffer, the first
-  // five characters are reserved [0-4] to store next free block
-  // number, that's why we start from 5
-  fcb.index = 5;
+  // To represent the current position in the buffer
+  fcb.index = 0;
+
+  // The buffer does not hold any block of the file yet
+  fcb.bufBlock = -1;
+  fcb.bufDirty = 0;
+  fcb.viewFirst = -1;
 
   // To represent the current position in the file
   fcb.offset = 0;
@@ -269,9 +402,26 @@ b_io_fd b_open(char* filename, int flags) {
   // If it's a new file then the file size is 0, else we need
   // to get that information from it's directory entry
   fcb.fileSize = dirEntry->fileSize;
+  fcb.written = 0;
+
+  // Read in the map of the blocks that hold the file's data. A file
+  // opened for appending only ever writes past its last block, so only
+  // the last map block is read no matter how large the file is
+  if (fcb.flags[4] - '0') {
+    int numBlocks = (fcb.fileSize + fcb.unitSize - 1) / fcb.unitSize;
+    if (dirEntry->compressed) {
+      numBlocks *= 2;   //every chunk has 2 entries in the chunk index
+    }
+    fcb.map = mapLoadTail(dirEntry->location, dirEntry->tailMap, numBlocks);
+    fcb.map->chunked = dirEntry->compressed;
+  } else {
+    fcb.map = mapLoadEntry(dirEntry);
+  }
 
-  // To represent the location at which the current file starts
-  fcb.location = dirEntry->location;
+  // A small file with no blocks keeps its data in its directory entry,
+  // so reading it takes no I/O beyond reading the directory
+  fcb.isInline = dirEntry->location == 0 &&
+    dirEntry->fileSize <= MAX_INLINE_SIZE;
 
   // To represent the directory that contains our file
   fcb.directory = parentDir;
@@ -279,293 +429,1742 @@ b_io_fd b_open(char* filename, int flags) {
   // To represent the directory entry associated with our file
   fcb.entry = dirEntry;
 
-  fcbArray[returnFd] = fcb;
+  // The checksums are read in before the file is read, after which reads
+  // running at once can all check their data against them
+  loadChecksumTable();
+
+  // The defragmenter gives up on a file that is opened while it moves it
+  if (parentDir->location == watchedDir &&
+    strcmp(dirEntry->filename, watchedName) == 0) {
+    watchedOpened = 1;
+  }
+
+  returnFd = b_getFCB();	// get our own file descriptor
+  *fcbAt(returnFd) = fcb;
 
   return (returnFd);	// all set
 }
 
+// Interface to open a buffered file
+// Modification of interface for this assignment, flags match the Linux flags for open
+// O_RDONLY, O_WRONLY, or O_RDWR
+b_io_fd b_open(char* filename, int flags) {
+  lockVolume(1);
+  b_io_fd fd = openFile(filename, flags);
+  unlockVolume();
+  return fd;
+}
+
 
 // Interface to seek function	
-int b_seek(b_io_fd fd, off_t offset, int whence) {
+off_t b_seek(b_io_fd fd, off_t offset, int whence) {
   if (startup == 0) b_init();  //Initialize our system
 
-  // check that fd is between 0 and (MAXFCBS-1)
-  if ((fd < 0) || (fd >= MAXFCBS)) {
+  // check that fd is in the FCB table
+  if ((fd < 0) || (fd >= numFcbs)) {
     return (-1); 					//invalid file descriptor
   }
 
+  lockVolume(0);
+  lockFile(fd, 1);
+
   // If whence is SEEK_SET, we need to need to set the file's
   // index to the offset provided
-  if (whence == SEEK_SET) {
-    fcbArray[fd].offset = offset;
+  off_t newOffset = -1;
+  if (fcbAt(fd)->buf == NULL) {
+    newOffset = -1;   //file is not open
+  } else if (whence == SEEK_SET) {
+    fcbAt(fd)->offset = offset;
+    newOffset = fcbAt(fd)->offset;
   }
 
   // If whence is SEEK_CUR, we need to add offset to the file's
   // current position (index)
   else if (whence == SEEK_CUR) {
-    fcbArray[fd].offset += offset;
+    fcbAt(fd)->offset += offset;
+    newOffset = fcbAt(fd)->offset;
   }
 
   // If whence is SEEK_END, we need to set the file's index to
   // the size of the file plus offset
   else if (whence == SEEK_END) {
-    fcbArray[fd].offset = fcbArray[fd].fileSize + offset;
+    fcbAt(fd)->offset = fcbAt(fd)->fileSize + offset;
+    newOffset = fcbAt(fd)->offset;
   }
 
-  // We return -1 indicating that the value passed for whence is
-  // not valid
-  else {
-    return -1;
-  }
+  // Otherwise we return -1 indicating that the value passed for whence
+  // is not valid
+
+  unlockFile(fd);
+  unlockVolume();
 
   // Upon success return the new offset position starting from the
   // beginning of the file
-  return fcbArray[fd].offset;
+  return newOffset;
 }
 
 
 
-// Interface to write function	
-int b_write(b_io_fd fd, char* buffer, int count) {
-  if (startup == 0) b_init();  //Initialize our system
+// Gives logical blocks lb onwards of the file a run of contiguous
+// clusters, up to numBlocks long, and stores the run's length (in logical
+// blocks) in runLength
+int allocateRun(b_fcb* fcb, int lb, int numBlocks, int* runLength) {
+  int runBlocks;
+  int freeBlock = getFreeRun(numBlocks * clusterBlocks, &runBlocks);
+  // Check if the freeBlock returned is valid or not
+  if (freeBlock < 0) {
+    return -1;
+  }
 
-  // check that fd is between 0 and (MAXFCBS-1)
-  if ((fd < 0) || (fd >= MAXFCBS)) {
-    return (-1); 					//invalid file descriptor
+  setBlocksAsAllocated(freeBlock, runBlocks);
+  *runLength = runBlocks / clusterBlocks;
+  for (int i = 0; i < *runLength; i++) {
+    mapSet(fcb->map, lb + i, freeBlock + i * clusterBlocks);
   }
 
-  b_fcb fcb = fcbArray[fd];
+  return freeBlock;
+}
 
-  // We first check if this file has write flag set or not, indicating
-  // write permission
-  if (!(fcb.flags[1] - '0')) {
-    printf("ERROR: Cannot write to this file\n");
-    return -1;
+// Returns the volume block that holds logical block lb of the file,
+// giving the file a new block if it does not have one yet. Blocks that
+// are skipped over by writing past the end of the file are left as holes
+// in the map, which take no space and read back as zeros.
+int getWriteBlock(b_fcb* fcb, int lb) {
+  int block = mapGet(fcb->map, lb);
+
+  // A block shared with other files is never written over, the file
+  // drops its reference and gets a block of its own instead
+  if (block && isShared(block)) {
+    setBlocksAsFree(block, clusterBlocks);
+    mapSet(fcb->map, lb, 0);
+    block = 0;
   }
 
+  if (block) {
+    return block;
+  }
 
-  // This represents the amount of text we can store in our
-  // buffer, it's 5 less than 512 because we reserve 5 character
-  // to store characters representing next block associated with
-  // the file
-  fcb.buflen = blockSize - fcb.index;
+  int runLength;
+  return allocateRun(fcb, lb, 1, &runLength);
+}
 
-  int numBytesWritten = 0;
+// Makes logical block lb of the file share a cluster already on the volume
+// that holds the same data, returning 1 if it did and 0 if there is none
+int dedupBlock(b_fcb* fcb, int lb, char* data, uint64_t hash) {
+  int duplicate = findDuplicate(data, hash);
+  if (!duplicate) {
+    return 0;
+  }
 
-  // Next we write the number of bytes specified in the count variable
-  // from the provided buffer to our file
-  for (int i = 0; i < count; i++) {
-    if (fcb.buflen >= 1) {
-      fcb.buf[fcb.index] = buffer[i];
-      fcb.index++;
-      fcb.fileSize++;
-      numBytesWritten++;
-      fcb.buflen--;
-      fcb.offset++;
-    }
-
-    if (fcb.buflen < 1) {
-      // Since we have reached the limit of our current buffer we
-      // need to write it to the volume
-      int freeBlock = getFreeBlockNum(1);
-      // Check if the freeBlock returned is valid or not
-      if (freeBlock < 0) {
-        return -1;
-      }
+  int block = mapGet(fcb->map, lb);
+  if (duplicate == block) {
+    return 1;     //the block already holds this data
+  }
 
-      // We need to create a copy of freeBlock, because
-      // we don't want the original freeBlock to get modified
-      int numb = freeBlock;
+  if (!addRef(duplicate)) {
+    return 0;
+  }
+  if (block) {
+    setBlocksAsFree(block, clusterBlocks);
+  }
+  mapSet(fcb->map, lb, duplicate);
+  return 1;
+}
 
-      // The following algorithm will break the next freeBlock
-      // number into separate digits which we will store as
-      // characters and when we need to get the block
-      // number we can rejoin those digits to get an int
-      int j = 4;
-      while (numb > 0) {
-        int mod = numb % 10;
-        fcb.buf[j] = mod + '0';
-        numb = numb / 10;
-        j--;
-      }
+// Number of bytes of the file that are in logical block lb
+int validBytes(b_fcb* fcb, int lb) {
+  off_t bytes = fcb->fileSize - (off_t)lb * fcb->unitSize;
+  if (bytes < 0) {
+    return 0;
+  }
+  return bytes > fcb->unitSize ? fcb->unitSize : bytes;
+}
 
-      // If the block number is less than 5 digits
-      // we need to store leading zeros
-      while (j >= 0) {
-        fcb.buf[j] = 0 + '0';
-        j--;
-      }
+// Compresses the chunk in our buffer and writes it to a run of clusters.
+// A chunk that would not take up fewer clusters compressed is stored raw.
+int writeChunk(b_fcb* fcb) {
+  int lb = fcb->bufBlock;
+  int length = validBytes(fcb, lb);
+
+  char* packed = calloc(fcb->unitSize, 1);
+  if (!packed) {
+    mallocFailed();
+  }
 
-      LBAwrite(fcb.buf, 1, fcb.location);
+  // Compressing only pays off if it saves at least one cluster
+  int rawClusters = chunkClusters(length);
+  int storedLen = -length;
+  if (rawClusters > 1) {
+    int packedLen = lzCompress(fcb->buf, length, packed,
+      (rawClusters - 1) * clusterSize);
+    if (packedLen > 0) {
+      storedLen = packedLen;
+    }
+  }
+  char* data = storedLen > 0 ? packed : fcb->buf;
+  int numClusters = chunkClusters(storedLen);
+
+  // The chunk stays where it is if it still takes the same number of
+  // clusters, otherwise it moves to a run of the new length
+  // A chunk shared with other files is never written over either
+  int block = mapGet(fcb->map, 2 * lb);
+  if (!block || isShared(block) ||
+    chunkClusters(mapGet(fcb->map, 2 * lb + 1)) != numClusters) {
+    int newBlock = getFreeBlockNum(numClusters * clusterBlocks);
+    // Check if the newBlock returned is valid or not
+    if (newBlock < 0) {
+      free(packed);
+      packed = NULL;
+      return -1;
+    }
+    setBlocksAsAllocated(newBlock, numClusters * clusterBlocks);
 
-      setBlocksAsAllocated(freeBlock, 1);
+    if (block) {
+      setBlocksAsFree(block,
+        chunkClusters(mapGet(fcb->map, 2 * lb + 1)) * clusterBlocks);
+    }
+    block = newBlock;
+  }
 
-      // We now set the location to the next free block it will be
-      // useful when we need to write next block to our volume
-      fcb.location = freeBlock;
+  deviceWrite(data, numClusters * clusterBlocks, block);
+  setChecksums(data, block, numClusters);
+  mapSet(fcb->map, 2 * lb, block);
+  mapSet(fcb->map, 2 * lb + 1, storedLen);
 
-      free(fcb.buf);
-      fcb.buf = NULL;
+  free(packed);
+  packed = NULL;
+  return 0;
+}
 
-      fcb.buf = calloc(blockSize, 1);
-      if (!fcb.buf) {
-        mallocFailed();
-      }
+// Reads chunk lb of a compressed file into dest, which holds a chunk
+int readChunk(b_fcb* fcb, int lb, char* dest) {
+  int block = mapGet(fcb->map, 2 * lb);
+  int storedLen = mapGet(fcb->map, 2 * lb + 1);
 
-      // Since we start with a new buffer we reset the index and buflen
-      fcb.index = 5;
-      fcb.buflen = blockSize - fcb.index;
-    }
+  memset(dest, 0, fcb->unitSize);
+  if (!block) {
+    return 0;
   }
 
-
-  // Write the remaining block to the disk
-  if (fcb.index != 5) {
-    // Put 0s as a placeholder for next block 
-    for (int i = 0; i < 5; i++) {
-      fcb.buf[i] = 0 + '0';
+  int numClusters = chunkClusters(storedLen);
+  if (storedLen < 0) {
+    deviceRead(dest, numClusters * clusterBlocks, block);
+    if (!checksumsMatch(dest, block, numClusters)) {
+      printf("Error: chunk %d of %s is corrupt\n", lb, fcb->entry->filename);
+      return -1;
     }
-    LBAwrite(fcb.buf, 1, fcb.location);
-    setBlocksAsAllocated(fcb.location, 1);
+    return 0;
   }
 
-  fcbArray[fd] = fcb;
-
+  char* packed = malloc(numClusters * clusterSize);
+  if (!packed) {
+    mallocFailed();
+  }
 
-  // To indicate that the write function worked correctly we return
-  // the number of bytes written
-  return numBytesWritten;
-}
+  deviceRead(packed, numClusters * clusterBlocks, block);
+  int length = -1;
+  if (checksumsMatch(packed, block, numClusters)) {
+    length = lzDecompress(packed, storedLen, dest, fcb->unitSize);
+  }
 
+  free(packed);
+  packed = NULL;
 
+  if (length < 0) {
+    printf("Error: chunk %d of %s is corrupt\n", lb, fcb->entry->filename);
+    return -1;
+  }
+  return 0;
+}
 
-// Interface to read a buffer
+// Writes the buffer out to the volume if it has changes in it
+int flushBuffer(b_fcb* fcb) {
+  if (!fcb->bufDirty) {
+    return 0;
+  }
 
-// Filling the callers request is broken into three parts
-// Part 1 is what can be filled from the current buffer, which may or may not be enough
-// Part 2 is after using what was left in our buffer there is still 1 or more block
-//        size chunks needed to fill the callers request. This represents the number of
-//        bytes in multiples of the blocksize.
-// Part 3 is a value less than blocksize which is what remains to copy to the callers buffer
-//        after fulfilling part 1 and part 2.  This would always be filled from a refill 
-//        of our buffer.
-//  +-------------+------------------------------------------------+--------+
-//  |             |                                                |        |
-//  | filled from |  filled direct in multiples of the block size  | filled |
-//  | existing    |                                                | from   |
-//  | buffer      |                                                |refilled|
-//  |             |                                                | buffer |
-//  |             |                                                |        |
-//  | Part1       |  Part 2                                        | Part3  |
-//  +-------------+------------------------------------------------+--------+
-int b_read(b_io_fd fd, char* buffer, int count) {
+  // The data of an inline file goes back into its directory entry
+  if (fcb->isInline) {
+    memcpy(fcb->entry->inlineData, fcb->buf, fcb->fileSize);
+    fcb->entry->inlineLen = fcb->fileSize;
+    fcb->bufDirty = 0;
+    return 0;
+  }
 
-  if (startup == 0) b_init();  //Initialize our system
+  if (fcb->entry->compressed) {
+    if (writeChunk(fcb) < 0) {
+      return -1;
+    }
+    fcb->bufDirty = 0;
+    return 0;
+  }
 
-  // check that fd is between 0 and (MAXFCBS-1)
-  if ((fd < 0) || (fd >= MAXFCBS)) {
-    return (-1); 					//invalid file descriptor
+  // A full block of data that is already on the volume is shared instead
+  // of being written again. Only full blocks are hashed, since the data
+  // of a partial block can still change.
+  uint64_t hash = 0;
+  if (dedupEnabled() && validBytes(fcb, fcb->bufBlock) == clusterSize) {
+    hash = clusterHash(fcb->buf);
+    if (dedupBlock(fcb, fcb->bufBlock, fcb->buf, hash)) {
+      fcb->bufDirty = 0;
+      return 0;
+    }
   }
 
-  // Get the file control block associated with our current file
-  b_fcb fcb = fcbArray[fd];
+  // On a log-structured volume the block is appended to the log and the
+  // block it replaces is freed, otherwise it is written back in place
+  int block;
+  if (segmentsEnabled()) {
+    block = segmentAppend(fcb->buf);
+    if (block < 0) {
+      return -1;
+    }
 
+    int oldBlock = mapGet(fcb->map, fcb->bufBlock);
+    if (oldBlock) {
+      setBlocksAsFree(oldBlock, clusterBlocks);
+    }
+    mapSet(fcb->map, fcb->bufBlock, block);
+  } else {
+    block = getWriteBlock(fcb, fcb->bufBlock);
+    if (block < 0) {
+      return -1;
+    }
 
-  // We first check if this file has read flag set or not
-  if (!(fcb.flags[0] - '0')) {
-    printf("ERROR: Cannot read from this file\n");
-    return -1;
+    deviceWrite(fcb->buf, clusterBlocks, block);
   }
+  setChecksums(fcb->buf, block, 1);
+  setClusterHash(block, hash);
+  fcb->bufDirty = 0;
+  return 0;
+}
 
-  // We should only read upto the size of the source file
-  if (fcb.offset >= fcb.fileSize) {
-    return 0;
+// Loads logical block lb of the file into the buffer. Bytes past the end
+// of the file are zeroed so that they never show up if the file grows.
+int fillBuffer(b_fcb* fcb, int lb) {
+  if (flushBuffer(fcb) < 0) {
+    return -1;
   }
 
-  if (fcb.offset == 0) {
-    // Read the first block associated with the opened file
-    LBAread(fcb.buf, 1, fcb.location);
+  // Until the block is loaded the buffer holds no block of the file
+  fcb->bufBlock = -1;
+
+  if (fcb->isInline && lb == 0) {
+    memcpy(fcb->buf, fcb->entry->inlineData, fcb->entry->inlineLen);
+  } else if (fcb->entry->compressed) {
+    if (readChunk(fcb, lb, fcb->buf) < 0) {
+      return -1;
+    }
+  } else {
+    int block = mapGet(fcb->map, lb);
+    if (block) {
+      segmentRead(fcb->buf, clusterBlocks, block);
+      if (!checksumsMatch(fcb->buf, block, 1)) {
+        printf("Error: block %d of %s is corrupt\n", lb, fcb->entry->filename);
+        return -1;
+      }
+    } else {
+      memset(fcb->buf, 0, clusterSize);
+    }
   }
 
-  fcb.buflen = blockSize - fcb.index;
+  fcb->buflen = validBytes(fcb, lb);
+  memset(fcb->buf + fcb->buflen, 0, fcb->unitSize - fcb->buflen);
 
-  int numBytesRead = 0;
+  fcb->bufBlock = lb;
+  return 0;
+}
 
-  for (int i = 0; i < count; i++) {
-    // This marks the EOF
-    if (fcb.offset >= fcb.fileSize) {
-      fcbArray[fd] = fcb;
-      return numBytesRead;
+// Moves the data of an inline file out of its directory entry and into
+// our buffer, from where it gets written to a block like any other data
+int promoteInline(b_fcb* fcb) {
+  if (fcb->fileSize > 0) {
+    if (fcb->bufBlock != 0 && fillBuffer(fcb, 0) < 0) {
+      return -1;
     }
+    fcb->bufDirty = 1;
+  }
 
-    if (fcb.buflen >= 1) {
-      buffer[i] = fcb.buf[fcb.index];
-      fcb.index++;
-      numBytesRead++;
-      fcb.buflen--;
-      fcb.offset++;
-    }
+  fcb->isInline = 0;
+  fcb->entry->inlineLen = 0;
+  return 0;
+}
+
+// Starts noting whether the file called filename in the directory at
+// dirLocation gets opened, or stops if dirLocation is -1. The caller holds
+// the volume lock alone.
+void watchOpens(int dirLocation, char* filename) {
+  watchedDir = dirLocation;
+  strncpy(watchedName, filename, sizeof(watchedName) - 1);
+  watchedName[sizeof(watchedName) - 1] = '\0';
+  watchedOpened = 0;
+}
 
-    if (fcb.buflen < 1) {
-      // Get the characters representing next block number from the file
-      char blockChars[6];
+// Returns 1 if the file passed to watchOpens has been opened since
+int watchedFileOpened() {
+  return watchedOpened;
+}
+
+// Returns 1 if the file called filename in the directory at dirLocation
+// is open
+int fileIsOpen(int dirLocation, char* filename) {
+  int open = 0;
+
+  pthread_mutex_lock(&fcbTableLock);
+  for (int fd = 0; fd < numFcbs && !open; fd++) {
+    b_fcb* fcb = &fcbChunks[fd / FCB_CHUNK_SIZE]->fcbs[fd % FCB_CHUNK_SIZE];
+    open = fcb->buf != NULL && fcb->directory->location == dirLocation &&
+      strcmp(fcb->entry->filename, filename) == 0;
+  }
+  pthread_mutex_unlock(&fcbTableLock);
+
+  return open;
+}
+
+// Makes room for bytesNeeded more bytes of records in a directory by
+// moving the data of inline files that are not open out into blocks.
+// The caller is responsible for writing the directory out to the disk.
+int makeRoomInDir(hashTable* table, int bytesNeeded) {
+  for (int i = 0; i < SIZE; i++) {
+    for (node* n = table->entries[i]; n != NULL; n = n->next) {
+      if (table->maxDataSize - table->dataSize >= bytesNeeded) {
+        break;
+      }
 
-      for (int j = 0; j < 5; j++) {
-        blockChars[j] = fcb.buf[j];
+      dirEntry* entry = n->value;
+      if (entry->isDir || entry->inlineLen == 0) {
+        continue;
       }
-      blockChars[5] = '\0';
 
-      // Convert the characters representing block number to
-      // an integer
-      const char* constBlockNumbs = blockChars;
-      int nextBlock = atoi(constBlockNumbs);
+      // An open file would write its inline data back when it is closed
+      if (fileIsOpen(table->location, entry->filename)) {
+        continue;
+      }
 
-      free(fcb.buf);
-      fcb.buf = NULL;
+      int runLength;
+      int freeBlock = getFreeRun(clusterBlocks, &runLength);
+      // Check if the freeBlock returned is valid or not
+      if (freeBlock < 0) {
+        return 0;
+      }
+      setBlocksAsAllocated(freeBlock, clusterBlocks);
 
-      // Start reading remaining text from next buffer
-      fcb.buf = calloc(blockSize, 1);
-      if (!fcb.buf) {
+      char* buffer = calloc(clusterSize, 1);
+      if (!buffer) {
         mallocFailed();
       }
+      memcpy(buffer, entry->inlineData, entry->inlineLen);
+      deviceWrite(buffer, clusterBlocks, freeBlock);
+      setChecksums(buffer, freeBlock, 1);
+      free(buffer);
+      buffer = NULL;
 
-      // Start reading remaining text from next buffer
-      LBAread(fcb.buf, 1, nextBlock);
+      // The first chunk of a compressed file is stored raw, which a
+      // negative length in its chunk index entry marks
+      blockMap* map = mapLoad(0);
+      mapSet(map, 0, freeBlock);
+      if (entry->compressed) {
+        mapSet(map, 1, -entry->inlineLen);
+      }
+      entry->location = mapSave(map);
+      entry->tailMap = mapTail(map);
+      mapFree(map);
+      map = NULL;
 
-      // Since we start with a new buffer we reset the index and buflen
-      fcb.index = 5;
-      fcb.buflen = blockSize - fcb.index;
+      table->dataSize -= entry->inlineLen;
+      entry->inlineLen = 0;
     }
   }
 
-  fcbArray[fd] = fcb;
+  // The blocks the moved data now uses must be marked as allocated on
+  // the disk before the directory that points to them is written
+  writeFreeSpace();
 
-  return numBytesRead;
+  return table->maxDataSize - table->dataSize >= bytesNeeded;
 }
 
-// Interface to Close the file	
-void b_close(b_io_fd fd) {
-  // check that fd is between 0 and (MAXFCBS-1)
-  if ((fd < 0) || (fd >= MAXFCBS)) {
-    return; 					//invalid file descriptor
+// Writes to a file for b_write and b_pwrite, which hold the volume lock
+ssize_t writeFile(b_io_fd fd, char* buffer, size_t count) {
+  b_fcb fcb = *fcbAt(fd);
+
+  if (fcb.buf == NULL) {
+    return -1;        //file is not open
   }
 
-  b_fcb fcb = fcbArray[fd];
+  // The blocks in the view are read again by the next b_read_view, so
+  // that it sees this write. A view already lent out keeps its data.
+  fcb.viewFirst = -1;
 
-  // We need to write the directory entry representing
-  // the open file, since we might have changed the file's
-  // size, dateModified, or dateCreated fields
-  fcb.entry->fileSize = fcb.fileSize;
-  fcb.entry->dateModified = time(0);
+  // We first check if this file has write flag set or not, indicating
+  // write permission
+  if (!(fcb.flags[1] - '0')) {
+    printf("ERROR: Cannot write to this file\n");
+    return -1;
+  }
 
-  setEntry(fcb.entry->filename, fcb.entry, fcb.directory);
+  // In append mode every write goes to the end of the file, which the
+  // tail of the map and the tail fill (fileSize % unitSize) locate
+  if (fcb.flags[4] - '0') {
+    fcb.offset = fcb.fileSize;
+  }
 
-  writeTableData(fcb.directory, fcb.directory->location);
+  // An inline file that outgrows its directory entry gets real blocks
+  if (fcb.isInline && fcb.offset + (off_t)count > MAX_INLINE_SIZE &&
+    promoteInline(&fcb) < 0) {
+    return -1;
+  }
+
+  size_t numBytesWritten = 0;
+
+  // Next we write the number of bytes specified in the count variable
+  // from the provided buffer to our file, starting at the file's offset
+  while (numBytesWritten < count) {
+    int lb = fcb.offset / fcb.unitSize;
+    fcb.index = fcb.offset % fcb.unitSize;
+    size_t remaining = count - numBytesWritten;
+
+    // The request starts partway into a block, ends before the end of a
+    // block, the block is already in our buffer, or the file is compressed
+    // a chunk at a time, so we copy the span that belongs in this block
+    // into our buffer
+    if (fcb.index != 0 || remaining < fcb.unitSize || fcb.bufBlock == lb ||
+      fcb.entry->compressed) {
+      if (fcb.bufBlock != lb && fillBuffer(&fcb, lb) < 0) {
+        break;
+      }
+
+      int numBytes = fcb.unitSize - fcb.index;
+      if (numBytes > remaining) {
+        numBytes = remaining;
+      }
+
+      memcpy(fcb.buf + fcb.index, buffer + numBytesWritten, numBytes);
+      fcb.index += numBytes;
+      fcb.bufDirty = 1;
+      numBytesWritten += numBytes;
+      fcb.offset += numBytes;
+      if (fcb.offset > fcb.fileSize) {
+        fcb.fileSize = fcb.offset;
+      }
+
+      // Since we have reached the limit of our current buffer we
+      // need to write it to the volume
+      if (fcb.index == fcb.unitSize && flushBuffer(&fcb) < 0) {
+        break;
+      }
+      continue;
+    }
+
+    // Whole blocks are written straight from the caller's buffer. Blocks
+    // the file already has are overwritten a contiguous run at a time, and
+    // the blocks the file needs are allocated as runs, each written with
+    // a single LBAwrite
+    size_t numBlocks = remaining / clusterSize;
+    if (numBlocks > INT_MAX / clusterBlocks) {
+      numBlocks = INT_MAX / clusterBlocks;  //longest run one LBA call takes
+    }
+    // With dedup, a block whose data is already on the volume is shared,
+    // and the run only goes up to the next block that can be shared
+    uint64_t runHashes[DEDUP_RUN_MAX];
+    if (dedupEnabled()) {
+      runHashes[0] = clusterHash(buffer + numBytesWritten);
+      if (dedupBlock(&fcb, lb, buffer + numBytesWritten, runHashes[0])) {
+        numBytesWritten += clusterSize;
+        fcb.offset += clusterSize;
+        if (fcb.offset > fcb.fileSize) {
+          fcb.fileSize = fcb.offset;
+        }
+        continue;
+      }
+
+      size_t unique = 1;
+      while (unique < numBlocks && unique < DEDUP_RUN_MAX) {
+        char* data = buffer + numBytesWritten + unique * clusterSize;
+        runHashes[unique] = clusterHash(data);
+        if (findDuplicate(data, runHashes[unique])) {
+          break;
+        }
+        unique++;
+      }
+      numBlocks = unique;
+    }
+
+    int firstBlock = mapGet(fcb.map, lb);
+    int run = 1;
+
+    // A block shared with other files is never written over, the file
+    // drops its reference and gets blocks of its own instead
+    if (firstBlock && isShared(firstBlock)) {
+      setBlocksAsFree(firstBlock, clusterBlocks);
+      mapSet(fcb.map, lb, 0);
+      firstBlock = 0;
+    }
+
+    if (firstBlock) {
+      while (run < numBlocks &&
+        mapGet(fcb.map, lb + run) == firstBlock + run * clusterBlocks &&
+        !isShared(firstBlock + run * clusterBlocks)) {
+        run++;
+      }
+    } else {
+      int unmapped = 1;
+      while (unmapped < numBlocks && !mapGet(fcb.map, lb + unmapped)) {
+        unmapped++;
+      }
+
+      firstBlock = allocateRun(&fcb, lb, unmapped, &run);
+      if (firstBlock < 0) {
+        break;
+      }
+    }
+
+    // Whole blocks already go out as one large write, so they are written
+    // in place even on a log-structured volume, replacing any copy of them
+    // still waiting in the log
+    segmentDiscard(firstBlock, run * clusterBlocks);
+    deviceWrite(buffer + numBytesWritten, run * clusterBlocks, firstBlock);
+    setChecksums(buffer + numBytesWritten, firstBlock, run);
+    for (int i = 0; dedupEnabled() && i < run; i++) {
+      setClusterHash(firstBlock + i * clusterBlocks, runHashes[i]);
+    }
+
+    // Whatever the buffer held for these blocks is now out of date
+    if (fcb.bufBlock >= lb && fcb.bufBlock < lb + run) {
+      fcb.bufBlock = -1;
+      fcb.bufDirty = 0;
+    }
+
+    numBytesWritten += (size_t)run * clusterSize;
+    fcb.offset += (size_t)run * clusterSize;
+    if (fcb.offset > fcb.fileSize) {
+      fcb.fileSize = fcb.offset;
+    }
+  }
+
+  // A partially filled block stays in our buffer until it is full, the
+  // file is flushed or closed, or another block needs the buffer, so that
+  // small writes do not each cost a write to the disk
+  if (numBytesWritten > 0) {
+    fcb.written = 1;
+  }
+
+  *fcbAt(fd) = fcb;
+
+
+  // To indicate that the write function worked correctly we return
+  // the number of bytes written
+  return numBytesWritten;
+}
+
+// Interface to write function	
+ssize_t b_write(b_io_fd fd, char* buffer, size_t count) {
+  if (startup == 0) b_init();  //Initialize our system
+
+  // check that fd is in the FCB table
+  if ((fd < 0) || (fd >= numFcbs)) {
+    return (-1); 					//invalid file descriptor
+  }
+
+  lockVolume(1);
+  ssize_t numBytesWritten = writeFile(fd, buffer, count);
+  unlockVolume();
+
+  return numBytesWritten;
+}
+
+// Interface to write at offset without moving the file's offset
+ssize_t b_pwrite(b_io_fd fd, char* buffer, size_t count, off_t offset) {
+  if (startup == 0) b_init();  //Initialize our system
+
+  // check that fd is in the FCB table
+  if ((fd < 0) || (fd >= numFcbs) || offset < 0) {
+    return (-1); 					//invalid file descriptor
+  }
+
+  // No other call sees the file's offset while the volume lock is held
+  // alone, so the write is made at offset like any other write and the
+  // offset is then put back
+  lockVolume(1);
+  off_t saved = fcbAt(fd)->offset;
+  fcbAt(fd)->offset = offset;
+  ssize_t numBytesWritten = writeFile(fd, buffer, count);
+  fcbAt(fd)->offset = saved;
+  unlockVolume();
+
+  return numBytesWritten;
+}
+
+
+
+// Interface to read a buffer
+
+// Filling the callers request is broken into three parts
+// Part 1 is what can be filled from the current buffer, which may or may not be enough
+// Part 2 is after using what was left in our buffer there is still 1 or more block
+//        size chunks needed to fill the callers request. This represents the number of
+//        bytes in multiples of the blocksize.
+// Part 3 is a value less than blocksize which is what remains to copy to the callers buffer
+//        after fulfilling part 1 and part 2.  This would always be filled from a refill 
+//        of our buffer.
+//  +-------------+------------------------------------------------+--------+
+//  |             |                                                |        |
+//  | filled from |  filled direct in multiples of the block size  | filled |
+//  | existing    |                                                | from   |
+//  | buffer      |                                                |refilled|
+//  |             |                                                | buffer |
+//  |             |                                                |        |
+//  | Part1       |  Part 2                                        | Part3  |
+//  +-------------+------------------------------------------------+--------+
+ssize_t readFile(b_io_fd fd, char* buffer, size_t count) {
+  // Get the file control block associated with our current file
+  b_fcb fcb = *fcbAt(fd);
+
+  if (fcb.buf == NULL) {
+    return -1;        //file is not open
+  }
+
+
+  // We first check if this file has read flag set or not
+  if (!(fcb.flags[0] - '0')) {
+    printf("ERROR: Cannot read from this file\n");
+    return -1;
+  }
+
+  // We should only read upto the size of the source file
+  if (fcb.offset >= fcb.fileSize) {
+    return 0;
+  }
+
+  if ((off_t)count > fcb.fileSize - fcb.offset) {
+    count = fcb.fileSize - fcb.offset;
+  }
+
+  size_t numBytesRead = 0;
+  int failed = 0;     //1 if data could not be read, such as corrupt data
+
+  while (numBytesRead < count) {
+    int lb = fcb.offset / fcb.unitSize;
+    fcb.index = fcb.offset % fcb.unitSize;
+    size_t remaining = count - numBytesRead;
+
+    // Part 1 and 3: the request starts partway into a block, ends before
+    // the end of a block, the block is already in our buffer, or the file
+    // is decompressed a chunk at a time, so we copy the span we need out
+    // of our buffer
+    if (fcb.index != 0 || remaining < fcb.unitSize || fcb.bufBlock == lb ||
+      fcb.entry->compressed) {
+      if (fcb.bufBlock != lb && fillBuffer(&fcb, lb) < 0) {
+        failed = 1;
+        break;
+      }
+
+      int numBytes = fcb.unitSize - fcb.index;
+      if (numBytes > remaining) {
+        numBytes = remaining;
+      }
+
+      memcpy(buffer + numBytesRead, fcb.buf + fcb.index, numBytes);
+      fcb.index += numBytes;
+      numBytesRead += numBytes;
+      fcb.offset += numBytes;
+      continue;
+    }
+
+    // Part 2: whole blocks are read straight into the caller's buffer,
+    // with every run of blocks that are contiguous on the volume read
+    // by a single LBAread
+    int firstBlock = mapGet(fcb.map, lb);
+    size_t numBlocks = remaining / clusterSize;
+    if (numBlocks > INT_MAX / clusterBlocks) {
+      numBlocks = INT_MAX / clusterBlocks;  //longest run one LBA call takes
+    }
+    int run = 1;
+
+    // A hole in the file has no block on the volume, so it is read as zeros
+    // without any I/O. The run stops at the block in our buffer, since that
+    // block may have been written without being given a block yet.
+    if (!firstBlock) {
+      while (run < numBlocks && !mapGet(fcb.map, lb + run) &&
+        fcb.bufBlock != lb + run) {
+        run++;
+      }
+
+      memset(buffer + numBytesRead, 0, (size_t)run * clusterSize);
+      numBytesRead += (size_t)run * clusterSize;
+      fcb.offset += (size_t)run * clusterSize;
+      continue;
+    }
+
+    while (run < numBlocks &&
+      mapGet(fcb.map, lb + run) == firstBlock + run * clusterBlocks) {
+      run++;
+    }
+
+    // Changes to a block in the run that are still in our buffer have
+    // to reach the volume before the run is read
+    if (fcb.bufDirty && fcb.bufBlock >= lb && fcb.bufBlock < lb + run &&
+      flushBuffer(&fcb) < 0) {
+      failed = 1;
+      break;
+    }
+
+    segmentRead(buffer + numBytesRead, run * clusterBlocks, firstBlock);
+    if (!checksumsMatch(buffer + numBytesRead, firstBlock, run)) {
+      printf("Error: data of %s at offset %ld is corrupt\n",
+        fcb.entry->filename, (long)fcb.offset);
+      failed = 1;
+      break;
+    }
+    numBytesRead += (size_t)run * clusterSize;
+    fcb.offset += (size_t)run * clusterSize;
+  }
+
+  *fcbAt(fd) = fcb;
+
+  // A read that fails before any data was read is an error, otherwise the
+  // data before the failure is returned and the next read reports it
+  if (failed && numBytesRead == 0) {
+    return -1;
+  }
+
+  return numBytesRead;
+}
+
+// Interface to read a buffer
+ssize_t b_read(b_io_fd fd, char* buffer, size_t count) {
+
+  if (startup == 0) b_init();  //Initialize our system
+
+  // check that fd is in the FCB table
+  if ((fd < 0) || (fd >= numFcbs)) {
+    return (-1); 					//invalid file descriptor
+  }
+
+  lockVolume(0);
+  lockFile(fd, 1);
+
+  // Changes in the buffer are written to the volume before another block
+  // is read into it, so a read that may do that holds the volume alone
+  if (volumeDepth == 0 && fcbAt(fd)->bufDirty) {
+    unlockFile(fd);
+    unlockVolume();
+    lockVolume(1);
+  }
+
+  ssize_t numBytesRead = readFile(fd, buffer, count);
+
+  unlockFile(fd);
+  unlockVolume();
+
+  return numBytesRead;
+}
+
+// Reads count bytes of a file at offset for b_pread, without using the
+// file's offset or buffer, so that any number of reads of the file can run
+// at once. A block in the buffer is copied from it, since it may have
+// changes not yet written.
+ssize_t preadFile(b_fcb* fcb, char* buffer, size_t count, off_t offset) {
+  if (fcb->buf == NULL) {
+    return -1;        //file is not open
+  }
+
+  // We first check if this file has read flag set or not
+  if (!(fcb->flags[0] - '0')) {
+    printf("ERROR: Cannot read from this file\n");
+    return -1;
+  }
+
+  // We should only read upto the size of the source file
+  if (offset < 0) {
+    return -1;
+  }
+  if (offset >= fcb->fileSize) {
+    return 0;
+  }
+  if ((off_t)count > fcb->fileSize - offset) {
+    count = fcb->fileSize - offset;
+  }
+
+  char* unit = NULL;  //holds a block that is only partly read
+  size_t numBytesRead = 0;
+  int failed = 0;     //1 if data could not be read, such as corrupt data
+
+  while (numBytesRead < count) {
+    int lb = offset / fcb->unitSize;
+    int index = offset % fcb->unitSize;
+    size_t remaining = count - numBytesRead;
+    char* dest = buffer + numBytesRead;
+
+    size_t numBytes = fcb->unitSize - index;
+    if (numBytes > remaining) {
+      numBytes = remaining;
+    }
+
+    if (fcb->bufBlock == lb) {
+      memcpy(dest, fcb->buf + index, numBytes);
+    } else if (fcb->isInline && lb == 0) {
+      // Bytes past the data kept in the directory entry read as zeros
+      size_t inlineBytes = 0;
+      if (index < fcb->entry->inlineLen) {
+        inlineBytes = fcb->entry->inlineLen - index;
+      }
+      if (inlineBytes > numBytes) {
+        inlineBytes = numBytes;
+      }
+      memcpy(dest, fcb->entry->inlineData + index, inlineBytes);
+      memset(dest + inlineBytes, 0, numBytes - inlineBytes);
+    } else if (fcb->entry->compressed) {
+      if (!unit && !(unit = malloc(fcb->unitSize))) {
+        mallocFailed();
+      }
+      if (readChunk(fcb, lb, unit) < 0) {
+        failed = 1;
+        break;
+      }
+      memcpy(dest, unit + index, numBytes);
+    } else if (!mapGet(fcb->map, lb)) {
+      memset(dest, 0, numBytes);    //a hole reads as zeros
+    } else if (index == 0 && remaining >= clusterSize) {
+      // Whole blocks are read straight into the caller's buffer, a run of
+      // blocks that are contiguous on the volume at a time. The run stops
+      // at the block in the buffer.
+      int firstBlock = mapGet(fcb->map, lb);
+      size_t numBlocks = remaining / clusterSize;
+      if (numBlocks > INT_MAX / clusterBlocks) {
+        numBlocks = INT_MAX / clusterBlocks;  //longest run one LBA call takes
+      }
+      int run = 1;
+      while (run < numBlocks && fcb->bufBlock != lb + run &&
+        mapGet(fcb->map, lb + run) == firstBlock + run * clusterBlocks) {
+        run++;
+      }
+
+      segmentRead(dest, run * clusterBlocks, firstBlock);
+      if (!checksumsMatch(dest, firstBlock, run)) {
+        printf("Error: data of %s at offset %ld is corrupt\n",
+          fcb->entry->filename, (long)offset);
+        failed = 1;
+        break;
+      }
+      numBytes = (size_t)run * clusterSize;
+    } else {
+      int block = mapGet(fcb->map, lb);
+      if (!unit && !(unit = malloc(fcb->unitSize))) {
+        mallocFailed();
+      }
+      segmentRead(unit, clusterBlocks, block);
+      if (!checksumsMatch(unit, block, 1)) {
+        printf("Error: block %d of %s is corrupt\n", lb, fcb->entry->filename);
+        failed = 1;
+        break;
+      }
+      memcpy(dest, unit + index, numBytes);
+    }
+
+    numBytesRead += numBytes;
+    offset += numBytes;
+  }
+
+  free(unit);
+  unit = NULL;
+
+  // A read that fails before any data was read is an error, otherwise the
+  // data before the failure is returned and the next read reports it
+  if (failed && numBytesRead == 0) {
+    return -1;
+  }
+
+  return numBytesRead;
+}
+
+// Interface to read at offset without moving the file's offset
+ssize_t b_pread(b_io_fd fd, char* buffer, size_t count, off_t offset) {
+  if (startup == 0) b_init();  //Initialize our system
+
+  // check that fd is in the FCB table
+  if ((fd < 0) || (fd >= numFcbs)) {
+    return (-1); 					//invalid file descriptor
+  }
+
+  lockVolume(0);
+  lockFile(fd, 0);
+
+  // A file opened for appending has only the last block of its map read
+  // in, and the rest is read in by the first read before it, which only
+  // one thread can do
+  b_fcb* fcb = fcbAt(fd);
+  if (fcb->buf != NULL && fcb->map->base > 0) {
+    unlockFile(fd);
+    lockFile(fd, 1);
+  }
+
+  ssize_t numBytesRead = preadFile(fcb, buffer, count, offset);
+
+  unlockFile(fd);
+  unlockVolume();
+
+  return numBytesRead;
+}
+
+// Writes the file's buffered data, block map, and directory entry out
+// to the disk
+int commitFile(b_fcb* fcb) {
+  int result = flushBuffer(fcb);
+
+  // The parent directory is read in again so that changes made to it
+  // by other files since this one was opened are not lost
+  hashTable* parentDir = readTableData(fcb->directory->location);
+
+  // If the directory has no room left for an inline file's data, the
+  // data is written to a block instead
+  if (fcb->isInline &&
+    !hasRoomFor(fcb->entry->filename, fcb->entry, parentDir)) {
+    promoteInline(fcb);
+    result = flushBuffer(fcb);
+  }
+
+  // On a log-structured volume the file's new clusters may still only be
+  // in the open segment, and they must be on the disk before the map and
+  // directory entry that point to them, or the old clusters they replace
+  // are freed
+  segmentFlush();
+
+  // We need to write the directory entry representing
+  // the open file, since we might have changed the file's
+  // size, dateModified, or location (block map) fields
+  if (fcb->map->dirty) {
+    fcb->entry->location = mapSave(fcb->map);
+    fcb->entry->tailMap = mapTail(fcb->map);
+  }
+
+  // The blocks the file now uses must be marked as allocated on the disk
+  // before the directory entry that points to them is written
+  writeFreeSpace();
+
+  fcb->entry->fileSize = fcb->fileSize;
+  if (fcb->written) {
+    fcb->entry->dateModified = time(0);
+    fcb->written = 0;
+  }
+
+  setEntry(fcb->entry->filename, fcb->entry, parentDir);
+  writeTableData(parentDir, parentDir->location);
+  parentDir = NULL;
+
+  // The directory entry must not be left held back by a parity volume
+  deviceFlush();
+
+  return result;
+}
+
+// Reads up to count bytes at the file's offset into the file's view for
+// b_read_view, as many logical blocks as are contiguous on the volume with
+// a single read, and points view at them. A block in our buffer is
+// copied from it instead, since it may have changes not yet written. The
+// blocks stay in the view until the file is written, so views of small
+// pieces of a block after one another only read it once.
+ssize_t viewFile(b_fcb* fcb, size_t count, const char** view) {
+  if (fcb->buf == NULL) {
+    return -1;        //file is not open
+  }
+
+  // We first check if this file has read flag set or not
+  if (!(fcb->flags[0] - '0')) {
+    printf("ERROR: Cannot read from this file\n");
+    return -1;
+  }
+
+  // The data lent out stays as it is until it is given back
+  if (fcb->viewHeld) {
+    printf("Error: the view of %s must be released first\n",
+      fcb->entry->filename);
+    return -1;
+  }
+
+  // We should only read upto the size of the source file
+  if (fcb->offset >= fcb->fileSize || count == 0) {
+    return 0;
+  }
+  if ((off_t)count > fcb->fileSize - fcb->offset) {
+    count = fcb->fileSize - fcb->offset;
+  }
+
+  int lb = fcb->offset / fcb->unitSize;
+  int index = fcb->offset % fcb->unitSize;
+
+  if (fcb->viewFirst >= 0 && lb >= fcb->viewFirst &&
+    lb < fcb->viewFirst + fcb->viewUnits) {
+    size_t start = (size_t)(lb - fcb->viewFirst) * fcb->unitSize + index;
+    size_t numBytes = (size_t)fcb->viewUnits * fcb->unitSize - start;
+    if (numBytes > count) {
+      numBytes = count;
+    }
+
+    *view = fcb->view + start;
+    fcb->viewHeld = 1;
+    fcb->offset += numBytes;
+    return numBytes;
+  }
+
+  // The view is one logical block, or a run of them that are all holes
+  // or contiguous on the volume. The run stops at the block in our buffer.
+  int firstBlock = 0;
+  int numUnits = 1;
+  if (fcb->bufBlock != lb && !fcb->isInline && !fcb->entry->compressed) {
+    firstBlock = mapGet(fcb->map, lb);
+    size_t wanted = (index + count + fcb->unitSize - 1) / fcb->unitSize;
+    size_t maxUnits = VIEW_MAX_SIZE / fcb->unitSize;
+    if (wanted > maxUnits) {
+      wanted = maxUnits > 0 ? maxUnits : 1;
+    }
+
+    while (numUnits < wanted && fcb->bufBlock != lb + numUnits) {
+      int block = mapGet(fcb->map, lb + numUnits);
+      if (firstBlock ? block != firstBlock + numUnits * clusterBlocks :
+        block != 0) {
+        break;
+      }
+      numUnits++;
+    }
+  }
+
+  size_t viewSize = (size_t)numUnits * fcb->unitSize;
+  fcb->viewFirst = -1;
+  if (viewSize > fcb->viewSize) {
+    free(fcb->view);
+    fcb->view = malloc(viewSize);
+    if (!fcb->view) {
+      mallocFailed();
+    }
+    fcb->viewSize = viewSize;
+  }
+
+  if (fcb->bufBlock == lb) {
+    memcpy(fcb->view, fcb->buf, fcb->unitSize);
+  } else if (fcb->isInline && lb == 0) {
+    memcpy(fcb->view, fcb->entry->inlineData, fcb->entry->inlineLen);
+    memset(fcb->view + fcb->entry->inlineLen, 0,
+      fcb->unitSize - fcb->entry->inlineLen);
+  } else if (fcb->entry->compressed) {
+    if (readChunk(fcb, lb, fcb->view) < 0) {
+      return -1;
+    }
+  } else if (!firstBlock) {
+    memset(fcb->view, 0, viewSize);    //a hole reads as zeros
+  } else {
+    segmentRead(fcb->view, numUnits * clusterBlocks, firstBlock);
+    if (!checksumsMatch(fcb->view, firstBlock, numUnits)) {
+      printf("Error: data of %s at offset %ld is corrupt\n",
+        fcb->entry->filename, (long)fcb->offset);
+      return -1;
+    }
+  }
+
+  fcb->viewFirst = lb;
+  fcb->viewUnits = numUnits;
+
+  size_t numBytes = viewSize - index;
+  if (numBytes > count) {
+    numBytes = count;
+  }
+
+  *view = fcb->view + index;
+  fcb->viewHeld = 1;
+  fcb->offset += numBytes;
+  return numBytes;
+}
+
+// Interface to read without copying into a caller's buffer
+ssize_t b_read_view(b_io_fd fd, size_t count, const char** view) {
+  if (startup == 0) b_init();  //Initialize our system
+
+  *view = NULL;
+
+  // check that fd is in the FCB table
+  if ((fd < 0) || (fd >= numFcbs)) {
+    return (-1); 					//invalid file descriptor
+  }
+
+  lockVolume(0);
+  lockFile(fd, 1);
+  ssize_t numBytes = viewFile(fcbAt(fd), count, view);
+  unlockFile(fd);
+  unlockVolume();
+
+  return numBytes;
+}
+
+// Interface to give back the data lent out by b_read_view
+int b_release_view(b_io_fd fd) {
+  // check that fd is in the FCB table
+  if ((fd < 0) || (fd >= numFcbs)) {
+    return (-1); 					//invalid file descriptor
+  }
+
+  lockVolume(0);
+  lockFile(fd, 1);
+  int result = fcbAt(fd)->viewHeld ? 0 : -1;
+  fcbAt(fd)->viewHeld = 0;
+  unlockFile(fd);
+  unlockVolume();
+
+  return result;
+}
+
+// Flushes a file for b_flush, which holds the volume lock
+int flushFile(b_io_fd fd) {
+  b_fcb fcb = *fcbAt(fd);
+
+  if (fcb.buf == NULL) {
+    return -1;        //file is not open
+  }
+
+  int result = commitFile(&fcb);
+
+  *fcbAt(fd) = fcb;
+
+  return result;
+}
+
+// Interface to flush the file's buffered writes to the disk
+int b_flush(b_io_fd fd) {
+  if (startup == 0) b_init();  //Initialize our system
+
+  // check that fd is in the FCB table
+  if ((fd < 0) || (fd >= numFcbs)) {
+    return (-1); 					//invalid file descriptor
+  }
+
+  lockVolume(1);
+  int result = flushFile(fd);
+  unlockVolume();
+
+  return result;
+}
+
+// Interface to flush the buffered writes of every open file to the disk
+void b_sync() {
+  lockVolume(1);
+  for (int fd = 0; fd < numFcbs; fd++) {
+    if (fcbAt(fd)->buf != NULL) {
+      flushFile(fd);
+    }
+  }
+  deviceFlush();
+  unlockVolume();
+}
+
+// Closes a file for b_close, which holds the volume lock
+void closeFile(b_io_fd fd) {
+  b_fcb fcb = *fcbAt(fd);
+
+  if (fcb.buf == NULL) {
+    return;           //file is not open
+  }
+
+  commitFile(&fcb);
+
+  clean(fcb.directory);
+  fcb.directory = NULL;
+
+  mapFree(fcb.map);
+  fcb.map = NULL;
+
+  // A view still held when the file is closed is no longer valid
+  free(fcb.view);
+  fcb.view = NULL;
+  fcb.viewHeld = 0;
 
   // To indicate that the fcb at fd is now free to use
   free(fcb.buf);
   fcb.buf = NULL;
 
-  fcbArray[fd] = fcb;
+  *fcbAt(fd) = fcb;
+  b_freeFCB(fd);
+
+}
+
+// Interface to Close the file	
+void b_close(b_io_fd fd) {
+  // check that fd is in the FCB table
+  if ((fd < 0) || (fd >= numFcbs)) {
+    return; 					//invalid file descriptor
+  }
+
+  lockVolume(1);
+  closeFile(fd);
+  unlockVolume();
+}
+
+// Gives a clone its own copy of the run of numClusters clusters starting
+// at block, returning where the copy starts
+int copyClusters(int block, int numClusters) {
+  int newBlock = getFreeBlockNum(numClusters * clusterBlocks);
+  // Check if the newBlock returned is valid or not
+  if (newBlock < 0) {
+    return -1;
+  }
+  setBlocksAsAllocated(newBlock, numClusters * clusterBlocks);
+
+  char* data = malloc(numClusters * clusterSize);
+  if (!data) {
+    mallocFailed();
+  }
+  segmentRead(data, numClusters * clusterBlocks, block);
+  deviceWrite(data, numClusters * clusterBlocks, newBlock);
+
+  // The copy keeps the checksums of the original, so that damage to the
+  // original's data is still caught in the copy
+  copyChecksums(block, newBlock, numClusters);
+  free(data);
+  data = NULL;
+
+  return newBlock;
+}
+
+// Returns a copy of a file's map in which every cluster the file uses has
+// one more reference, so the copy can be given to a clone of the file
+blockMap* shareMap(blockMap* srcMap) {
+  blockMap* map = mapCopy(srcMap);
+  int step = map->chunked ? 2 : 1;
+
+  for (int i = 0; i < map->numBlocks; i += step) {
+    int block = map->blocks[i];
+    if (!block) {
+      continue;     //holes are not shared, they take no space
+    }
+
+    // Every cluster of a chunk's run gets a reference. A run that has
+    // run out of references is copied for the clone instead.
+    int numClusters = map->chunked ? chunkClusters(map->blocks[i + 1]) : 1;
+    int shared = 0;
+    while (shared < numClusters && addRef(block + shared * clusterBlocks)) {
+      shared++;
+    }
+
+    if (shared < numClusters) {
+      setBlocksAsFree(block, shared * clusterBlocks);
+      int copy = copyClusters(block, numClusters);
+      if (copy < 0) {
+        // Drop the references given to the clone so far
+        map->numBlocks = i;
+        mapRelease(map);
+        mapFree(map);
+        return NULL;
+      }
+      map->blocks[i] = copy;
+    }
+  }
+
+  return map;
+}
+
+// Makes dest a copy of src for b_reflink, which holds the volume lock
+int reflinkFile(char* src, char* dest) {
+  if (!refsEnabled()) {
+    printf("Error: this volume cannot share blocks between files\n");
+    return -1;
+  }
+
+  if (!fs_isFile(src)) {
+    printf("Error: %s is not a file\n", src);
+    return -1;
+  }
+
+  deconPath* srcParts = splitPath(src);
+  hashTable* srcDir = getDir(srcParts->parentPath);
+  int srcDirLocation = srcDir->location;
+  clean(srcDir);
+  srcDir = NULL;
+
+  deconPath* destParts = splitPath(dest);
+  hashTable* destDir = getDir(destParts->parentPath);
+  if (!destDir) {
+    printf("ERROR: The parent path is invalid\n");
+    return -1;
+  }
+  int sameFile = destDir->location == srcDirLocation &&
+    strcmp(destParts->childName, srcParts->childName) == 0;
+  clean(destDir);
+  destDir = NULL;
+
+  if (sameFile) {
+    printf("Error: %s and %s are the same file\n", src, dest);
+    return -1;
+  }
+
+  // Changes to the source that are still in the buffer of an open file
+  // must be on the volume before its blocks are shared
+  for (int fd = 0; fd < numFcbs; fd++) {
+    if (fcbAt(fd)->buf != NULL &&
+      fcbAt(fd)->directory->location == srcDirLocation &&
+      strcmp(fcbAt(fd)->entry->filename, srcParts->childName) == 0) {
+      b_flush(fd);
+    }
+  }
+
+  srcDir = readTableData(srcDirLocation);
+  dirEntry* srcEntry = getEntry(srcParts->childName, srcDir);
+
+  blockMap* srcMap = mapLoadEntry(srcEntry);
+  blockMap* map = shareMap(srcMap);
+  mapFree(srcMap);
+  srcMap = NULL;
+
+  if (!map) {
+    clean(srcDir);
+    srcDir = NULL;
+    return -1;
+  }
+
+  // The clone starts out as an empty file that is then given the shared
+  // map, and closing it writes its map and directory entry
+  b_io_fd fd = b_open(dest, O_WRONLY | O_CREAT | O_TRUNC);
+  if (fd < 0) {
+    mapRelease(map);
+    mapFree(map);
+    map = NULL;
+    writeFreeSpace();
+    clean(srcDir);
+    srcDir = NULL;
+    return -1;
+  }
+
+  b_fcb* fcb = fcbAt(fd);
+
+  mapFree(fcb->map);
+  fcb->map = map;
+  fcb->fileSize = srcEntry->fileSize;
+  fcb->written = 1;
+
+  fcb->entry->compressed = srcEntry->compressed;
+  fcb->unitSize = clusterSize;
+  if (srcEntry->compressed && COMPRESS_CHUNK_SIZE > clusterSize) {
+    fcb->unitSize = COMPRESS_CHUNK_SIZE;
+  }
+  free(fcb->buf);
+  fcb->buf = calloc(fcb->unitSize, 1);
+  if (!fcb->buf) {
+    mallocFailed();
+  }
+
+  // The data of an inline file is simply copied
+  fcb->isInline = srcEntry->location == 0 &&
+    srcEntry->fileSize <= MAX_INLINE_SIZE;
+  memcpy(fcb->entry->inlineData, srcEntry->inlineData, srcEntry->inlineLen);
+  fcb->entry->inlineLen = srcEntry->inlineLen;
+
+  b_close(fd);
+
+  clean(srcDir);
+  srcDir = NULL;
+
+  return 0;
+}
+
+// Interface to make dest a copy of src that shares src's blocks instead
+// of copying them
+int b_reflink(char* src, char* dest) {
+  if (startup == 0) b_init();  //Initialize our system
+
+  lockVolume(1);
+  int result = reflinkFile(src, dest);
+  unlockVolume();
+
+  return result;
+}
+
+// Returns the number of clusters, up to maxBlocks, starting at srcOffset
+// in src and destOffset in dest that are holes in src and have no data
+// in dest either, so a copy can leave them as holes instead of writing
+// zeros (0 if the copy has to move data at these offsets). src and dest
+// may be the same file.
+int copyableHoles(b_fcb* src, off_t srcOffset, b_fcb* dest,
+  off_t destOffset, int maxBlocks) {
+  if (src->entry->compressed || dest->entry->compressed ||
+    src->isInline || dest->isInline ||
+    srcOffset % clusterSize != 0 || destOffset % clusterSize != 0) {
+    return 0;
+  }
+
+  int srcLb = srcOffset / clusterSize;
+  int destLb = destOffset / clusterSize;
+  int holes = 0;
+  while (holes < maxBlocks &&
+    !mapGet(src->map, srcLb + holes) && src->bufBlock != srcLb + holes &&
+    !mapGet(dest->map, destLb + holes) && dest->bufBlock != destLb + holes) {
+    holes++;
+  }
+
+  return holes;
+}
+
+// Copies a range between files for b_copy_range, which holds the volume
+// lock
+ssize_t copyRange(b_io_fd srcFd, off_t srcOffset, b_io_fd destFd,
+  off_t destOffset, size_t count) {
+  if (fcbAt(srcFd)->buf == NULL || fcbAt(destFd)->buf == NULL) {
+    return -1;        //file is not open
+  }
+
+  if (!(fcbAt(srcFd)->flags[0] - '0')) {
+    printf("ERROR: Cannot read from this file\n");
+    return -1;
+  }
+
+  if (!(fcbAt(destFd)->flags[1] - '0')) {
+    printf("ERROR: Cannot write to this file\n");
+    return -1;
+  }
+
+  // An append mode file is only ever written at its end, so it cannot
+  // be written at destOffset
+  if (fcbAt(destFd)->flags[4] - '0') {
+    printf("ERROR: Cannot copy into a file opened for appending\n");
+    return -1;
+  }
+
+  if (srcOffset < 0 || destOffset < 0) {
+    return -1;
+  }
+
+  if (srcFd == destFd && srcOffset < destOffset + (off_t)count &&
+    destOffset < srcOffset + (off_t)count) {
+    printf("Error: the ranges to copy between overlap\n");
+    return -1;
+  }
+
+  // The data moves through a staging buffer a whole number of clusters
+  // long, so that when both offsets are cluster aligned every run is read
+  // with a single LBAread and written to runs of clusters allocated
+  // together with a single LBAwrite
+  int stageSize = (COPY_RANGE_SIZE / clusterSize) * clusterSize;
+  if (stageSize < clusterSize) {
+    stageSize = clusterSize;
+  }
+  char* stage = malloc(stageSize);
+  if (!stage) {
+    mallocFailed();
+  }
+
+  // The copy leaves the offset of the destination where it was. The
+  // source is read without its offset, since it may be the same file.
+  off_t destSaved = fcbAt(destFd)->offset;
+
+  size_t numBytesCopied = 0;
+
+  while (numBytesCopied < count) {
+    off_t srcAt = srcOffset + numBytesCopied;
+    off_t destAt = destOffset + numBytesCopied;
+
+    off_t left = fcbAt(srcFd)->fileSize - srcAt;
+    if (left <= 0) {
+      break;          //the end of the source was reached
+    }
+    size_t remaining = count - numBytesCopied;
+    if ((off_t)remaining > left) {
+      remaining = left;
+    }
+
+    // An inline file the copy outgrows gets real blocks first, as it
+    // would in b_write
+    b_fcb* dest = fcbAt(destFd);
+    if (dest->isInline &&
+      destAt + (off_t)remaining > MAX_INLINE_SIZE &&
+      promoteInline(dest) < 0) {
+      break;
+    }
+
+    // Holes in the source stay holes in the copy
+    int holes = copyableHoles(fcbAt(srcFd), srcAt, dest, destAt,
+      remaining / clusterSize);
+    if (holes > 0) {
+      numBytesCopied += (size_t)holes * clusterSize;
+      if (destOffset + (off_t)numBytesCopied > dest->fileSize) {
+        dest->fileSize = destOffset + numBytesCopied;
+      }
+      dest->written = 1;
+      continue;
+    }
+
+    // A source offset that is not cluster aligned is brought into line
+    // by the first transfer so the ones after it can read whole clusters
+    size_t numBytes = stageSize - srcAt % clusterSize;
+    if (numBytes > remaining) {
+      numBytes = remaining;
+    }
+
+    ssize_t numRead = preadFile(fcbAt(srcFd), stage, numBytes, srcAt);
+    if (numRead <= 0) {
+      break;
+    }
+
+    // The destination's offset is only set once the source is read
+    fcbAt(destFd)->offset = destAt;
+    ssize_t numWritten = writeFile(destFd, stage, numRead);
+    if (numWritten > 0) {
+      numBytesCopied += numWritten;
+    }
+    if (numWritten < numRead) {
+      break;          //the volume is full
+    }
+  }
+
+  fcbAt(destFd)->offset = destSaved;
+
+  free(stage);
+  stage = NULL;
+
+  return numBytesCopied;
+}
+
+// Interface to copy count bytes from srcFd at srcOffset to destFd at
+// destOffset without going through a caller's buffer
+ssize_t b_copy_range(b_io_fd srcFd, off_t srcOffset, b_io_fd destFd,
+  off_t destOffset, size_t count) {
+  if (startup == 0) b_init();  //Initialize our system
+
+  // check that both fds are in the FCB table
+  if ((srcFd < 0) || (srcFd >= numFcbs) ||
+    (destFd < 0) || (destFd >= numFcbs)) {
+    return (-1); 					//invalid file descriptor
+  }
+
+  lockVolume(1);
+  ssize_t numBytesCopied = copyRange(srcFd, srcOffset, destFd, destOffset,
+    count);
+  unlockVolume();
+
+  return numBytesCopied;
+}
+
+// Zeroes the rest of the block that holds offset from, so that the bytes
+// after from read back as zeros if the file later grows past them
+int zeroTail(b_fcb* fcb, off_t from) {
+  int lb = from / fcb->unitSize;
+  int index = from % fcb->unitSize;
+
+  // A block boundary leaves nothing to zero, except in an inline file,
+  // whose data is all in its one block
+  if (index == 0 && !fcb->isInline) {
+    return 0;
+  }
+
+  // A hole already reads as zeros
+  int entry = fcb->entry->compressed ? 2 * lb : lb;
+  if (!fcb->isInline && !mapGet(fcb->map, entry) && fcb->bufBlock != lb) {
+    return 0;
+  }
+
+  if (fcb->bufBlock != lb && fillBuffer(fcb, lb) < 0) {
+    return -1;
+  }
+
+  memset(fcb->buf + index, 0, fcb->unitSize - index);
+  fcb->bufDirty = 1;
+  return 0;
+}
+
+// Sets the size of an open file for b_ftruncate, which holds the volume
+// lock
+int truncateFile(b_io_fd fd, off_t length) {
+  b_fcb fcb = *fcbAt(fd);
+  fcb.viewFirst = -1;
+
+  if (fcb.buf == NULL) {
+    return -1;        //file is not open
+  }
+
+  if (!(fcb.flags[1] - '0')) {
+    printf("ERROR: Cannot write to this file\n");
+    return -1;
+  }
+
+  if (length < 0) {
+    return -1;
+  }
+
+  if (length == fcb.fileSize) {
+    return 0;
+  }
+
+  // An inline file that grows past its directory entry gets real blocks
+  if (fcb.isInline && length > MAX_INLINE_SIZE && promoteInline(&fcb) < 0) {
+    return -1;
+  }
+
+  off_t from = fcb.fileSize;
+  if (length < fcb.fileSize) {
+    int numUnits = (length + fcb.unitSize - 1) / fcb.unitSize;
+
+    // What the buffer holds past the new end is dropped, not written
+    if (fcb.bufBlock >= numUnits) {
+      fcb.bufBlock = -1;
+      fcb.bufDirty = 0;
+    }
+
+    // The blocks past the new end are freed a run at a time
+    if (!fcb.isInline) {
+      mapTruncate(fcb.map, fcb.entry->compressed ? 2 * numUnits : numUnits);
+    }
+
+    fcb.fileSize = length;
+    from = length;
+  }
+
+  // The stale bytes after the old end of a file that grows, or the new
+  // end of one that shrinks, must not show up as file data
+  int result = zeroTail(&fcb, from);
+
+  fcb.fileSize = length;
+  fcb.written = 1;
+
+  // The new size and map are written with a single update of the
+  // directory entry
+  if (result == 0) {
+    result = commitFile(&fcb);
+  }
+
+  *fcbAt(fd) = fcb;
+
+  return result;
+}
+
+// Interface to set the size of an open file to length, freeing the blocks
+// past the new end or leaving a hole up to it
+int b_ftruncate(b_io_fd fd, off_t length) {
+  if (startup == 0) b_init();  //Initialize our system
+
+  // check that fd is in the FCB table
+  if ((fd < 0) || (fd >= numFcbs)) {
+    return (-1); 					//invalid file descriptor
+  }
+
+  lockVolume(1);
+  int result = truncateFile(fd, length);
+  unlockVolume();
+
+  return result;
+}
+
+// Interface to set the size of the file at path to length
+int b_truncate(char* path, off_t length) {
+  lockVolume(1);
+  if (!fs_isFile(path)) {
+    printf("Error: %s is not a file\n", path);
+    unlockVolume();
+    return -1;
+  }
+
+  b_io_fd fd = b_open(path, O_WRONLY);
+  if (fd < 0) {
+    unlockVolume();
+    return -1;
+  }
+
+  int result = b_ftruncate(fd, length);
+  b_close(fd);
+  unlockVolume();
 
+  return result;
 }
@@ -16,19 +16,91 @@
 #define _B_IO_H
 #include <fcntl.h>
 #include "fs_commands.h"
+#include "blockMap.h"
 
 typedef int b_io_fd;
 
+// Flag for b_open to store a new file compressed even if the volume does
+// not compress new files (it is not one of the Linux open flags)
+#define O_COMPRESS 0x40000000
+
 // Function to open the specified file for read/write operations
 // based on the flags specified, it returns a file descriptor
 // that gets used in other file functions as an identifier for 
 // a file
 b_io_fd b_open(char* filename, int flags);
-int b_read(b_io_fd fd, char* buffer, int count);
-int b_write(b_io_fd fd, char* buffer, int count);
-// Function to change the offset of a file
-int b_seek(b_io_fd fd, off_t offset, int whence);
+// Functions to read and write up to count bytes, they return the
+// number of bytes transferred or -1 on error
+ssize_t b_read(b_io_fd fd, char* buffer, size_t count);
+ssize_t b_write(b_io_fd fd, char* buffer, size_t count);
+// Functions to read and write up to count bytes at offset without using
+// or changing the file's offset. Any number of threads can read a file
+// with b_pread at once, while writes are made one at a time.
+ssize_t b_pread(b_io_fd fd, char* buffer, size_t count, off_t offset);
+ssize_t b_pwrite(b_io_fd fd, char* buffer, size_t count, off_t offset);
+// Function to read up to count bytes from the file's offset without
+// copying them, it sets view to read-only data that stays valid until
+// b_release_view is called and returns the number of bytes in it. As many
+// blocks as are contiguous on the volume are read at once, so fewer than
+// count bytes may be returned before the end of the file. It returns 0 at
+// the end of the file and -1 on error or if a view is already held.
+ssize_t b_read_view(b_io_fd fd, size_t count, const char** view);
+// Function to give back the view lent out by b_read_view, it returns 0
+// on success and -1 if the file has no view
+int b_release_view(b_io_fd fd);
+// Function to change the offset of a file, it returns the new offset
+off_t b_seek(b_io_fd fd, off_t offset, int whence);
+// Function to write a file's buffered changes out to the volume
+// without closing it
+int b_flush(b_io_fd fd);
 void b_close(b_io_fd fd);
+// Function to write the buffered changes of every open file out to the
+// volume
+void b_sync();
+
+// Functions to set the size of a file to length, freeing the blocks past
+// a new end that is shorter or leaving a hole up to one that is longer,
+// they return 0 on success and -1 on error
+int b_ftruncate(b_io_fd fd, off_t length);
+int b_truncate(char* path, off_t length);
+
+// Function to make dest a copy of src that shares src's blocks instead of
+// copying them, a shared block is copied when either file first writes
+// to it. It returns 0 on success and -1 if the blocks cannot be shared.
+int b_reflink(char* src, char* dest);
+
+// Function to copy up to count bytes from srcFd starting at srcOffset to
+// destFd starting at destOffset inside the volume, a run of clusters at
+// a time. The offsets of both files are left unchanged and holes in the
+// source stay holes. It returns the number of bytes copied or -1 on error.
+ssize_t b_copy_range(b_io_fd srcFd, off_t srcOffset, b_io_fd destFd,
+  off_t destOffset, size_t count);
+
+// Function to get a copy of a file's map in which every cluster the file
+// uses has one more reference, so the copy can be given to another file
+// that shares the clusters. It returns NULL if the volume is full.
+blockMap* shareMap(blockMap* srcMap);
+
+// Functions to hold the volume lock, alone if change is 1 and shared
+// otherwise, and to give it back. The b_ functions take it themselves, and
+// anything else that changes block maps, directories, or the free space
+// bit vector holds it alone while it does.
+void lockVolume(int change);
+void unlockVolume();
+
+// Function to check if the file called filename in the directory at
+// dirLocation is open, it returns 1 if it is
+int fileIsOpen(int dirLocation, char* filename);
+
+// Functions to note whether the file called filename in the directory at
+// dirLocation gets opened (dirLocation -1 stops), and to check if it was
+void watchOpens(int dirLocation, char* filename);
+int watchedFileOpened();
+
+// Function to make room for bytesNeeded more bytes of directory entries
+// in a directory by moving inline file data out into blocks, it returns
+// 1 if there is now enough room
+int makeRoomInDir(hashTable* table, int bytesNeeded);
 
 #endif
 
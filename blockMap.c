@@ -0,0 +1,397 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: blockMap.c
+*
+* Description: This file holds the functions used to read, update,
+* and write the block map of a file.
+*
+**************************************************************/
+
+#include "blockMap.h"
+
+//Number of block numbers that fit in a single map block
+int entriesPerMapBlock() {
+  return (clusterSize / sizeof(int)) - MAP_HEADER_INTS;
+}
+
+//Makes sure the map has room for at least numEntries entries
+void mapReserve(blockMap* map, int numEntries) {
+  if (numEntries <= map->capacity) {
+    return;
+  }
+
+  int newCapacity = map->capacity ? map->capacity : entriesPerMapBlock();
+  while (newCapacity < numEntries) {
+    newCapacity *= 2;
+  }
+
+  map->blocks = realloc(map->blocks, newCapacity * sizeof(int));
+  if (!map->blocks) {
+    mallocFailed();
+  }
+
+  //Logical blocks that have not been given a volume block yet are 0
+  memset(map->blocks + map->capacity, 0,
+    (newCapacity - map->capacity) * sizeof(int));
+  map->capacity = newCapacity;
+}
+
+//Adds a map block to the end of the list of map blocks read from disk
+void addMapLoc(blockMap* map, int location) {
+  if (map->numMapLocs == map->mapLocsCapacity) {
+    map->mapLocsCapacity = map->mapLocsCapacity ? map->mapLocsCapacity * 2 : 4;
+    map->mapLocs = realloc(map->mapLocs, map->mapLocsCapacity * sizeof(int));
+    if (!map->mapLocs) {
+      mallocFailed();
+    }
+  }
+
+  map->mapLocs[map->numMapLocs] = location;
+  map->numMapLocs++;
+}
+
+//Follows the chain of map blocks from location up to (but not including)
+//stopAt, appending each block's entries to the map
+void readMapChain(blockMap* map, int location, int stopAt) {
+  int* mapBlock = malloc(clusterSize);
+  if (!mapBlock) {
+    mallocFailed();
+  }
+
+  while (location && location != stopAt) {
+    deviceRead(mapBlock, clusterBlocks, location);
+    int count = mapBlock[1];
+
+    addMapLoc(map, location);
+
+    int loaded = map->numBlocks - map->base;
+    mapReserve(map, loaded + count);
+    memcpy(map->blocks + loaded, mapBlock + MAP_HEADER_INTS,
+      count * sizeof(int));
+    map->numBlocks += count;
+
+    location = mapBlock[0];
+  }
+
+  free(mapBlock);
+  mapBlock = NULL;
+}
+
+//Reads the block map whose first map block is at location (0 = empty file)
+blockMap* mapLoad(int location) {
+  blockMap* map = calloc(1, sizeof(blockMap));
+  if (!map) {
+    mallocFailed();
+  }
+
+  map->head = location;
+  readMapChain(map, location, 0);
+
+  return map;
+}
+
+//Reads the block map of the file of a directory entry
+blockMap* mapLoadEntry(dirEntry* entry) {
+  blockMap* map = mapLoad(entry->location);
+  map->chunked = entry->compressed;
+  return map;
+}
+
+//Number of clusters a chunk of a compressed file takes up on the volume
+//given its stored length
+int chunkClusters(int storedLen) {
+  int bytes = storedLen < 0 ? -storedLen : storedLen;
+  return (bytes + clusterSize - 1) / clusterSize;
+}
+
+//Reads only the last map block of a file with numBlocks logical blocks,
+//which is all that is needed to add blocks to the end of the file
+blockMap* mapLoadTail(int location, int tailMap, int numBlocks) {
+  int perBlock = entriesPerMapBlock();
+
+  //Every map block but the last one is full, so the last map block
+  //starts with the entry of this logical block
+  int base = numBlocks > 0 ? ((numBlocks - 1) / perBlock) * perBlock : 0;
+  if (!tailMap || base == 0) {
+    return mapLoad(location);
+  }
+
+  blockMap* map = calloc(1, sizeof(blockMap));
+  if (!map) {
+    mallocFailed();
+  }
+
+  map->head = location;
+  map->base = base;
+  map->numBlocks = base;
+  readMapChain(map, tailMap, 0);
+
+  //If the tail does not line up with the file's size read the whole map
+  if (map->numBlocks != numBlocks || map->numMapLocs != 1) {
+    mapFree(map);
+    return mapLoad(location);
+  }
+
+  return map;
+}
+
+//Reads the part of the map before the map's base so that the whole map
+//is in memory
+void mapLoadHead(blockMap* map) {
+  if (map->base == 0) {
+    return;
+  }
+
+  blockMap* head = calloc(1, sizeof(blockMap));
+  if (!head) {
+    mallocFailed();
+  }
+
+  readMapChain(head, map->head, map->mapLocs[0]);
+
+  //Add the entries and map blocks that were already in memory after
+  //the ones that were just read
+  int loaded = map->numBlocks - map->base;
+  mapReserve(head, head->numBlocks + loaded);
+  memcpy(head->blocks + head->numBlocks, map->blocks, loaded * sizeof(int));
+  head->numBlocks += loaded;
+
+  for (int i = 0; i < map->numMapLocs; i++) {
+    addMapLoc(head, map->mapLocs[i]);
+  }
+
+  free(map->blocks);
+  free(map->mapLocs);
+  map->blocks = head->blocks;
+  map->capacity = head->capacity;
+  map->mapLocs = head->mapLocs;
+  map->numMapLocs = head->numMapLocs;
+  map->mapLocsCapacity = head->mapLocsCapacity;
+  map->numBlocks = head->numBlocks;
+  map->base = 0;
+
+  free(head);
+  head = NULL;
+}
+
+//Writes the block map out to the disk and returns the location of its
+//first map block (0 if the file has no blocks)
+int mapSave(blockMap* map) {
+  //If the file no longer reaches past the map blocks we have in memory,
+  //the map block before them has to change so read in the whole map
+  if (map->base > 0 && map->numBlocks <= map->base) {
+    mapLoadHead(map);
+  }
+
+  int perBlock = entriesPerMapBlock();
+  int numEntries = map->numBlocks - map->base;
+  int needed = (numEntries + perBlock - 1) / perBlock;
+
+  //Free the map blocks we no longer need if the file got shorter
+  for (int i = needed; i < map->numMapLocs; i++) {
+    setBlocksAsFree(map->mapLocs[i], clusterBlocks);
+  }
+  if (needed < map->numMapLocs) {
+    map->numMapLocs = needed;
+  }
+
+  //Get more map blocks if the file got longer
+  while (map->numMapLocs < needed) {
+    int freeBlock = getMetadataBlockNum(clusterBlocks);
+    // Check if the freeBlock returned is valid or not
+    if (freeBlock < 0) {
+      needed = map->numMapLocs;
+      break;
+    }
+    setBlocksAsAllocated(freeBlock, clusterBlocks);
+    addMapLoc(map, freeBlock);
+  }
+
+  int* mapBlock = calloc(clusterSize, 1);
+  if (!mapBlock) {
+    mallocFailed();
+  }
+
+  //Write each map block with a link to the next one in the chain
+  for (int i = 0; i < needed; i++) {
+    int first = i * perBlock;
+    int count = numEntries - first < perBlock ? numEntries - first : perBlock;
+
+    mapBlock[0] = i + 1 < needed ? map->mapLocs[i + 1] : 0;
+    mapBlock[1] = count;
+    memcpy(mapBlock + MAP_HEADER_INTS, map->blocks + first, count * sizeof(int));
+    deviceWrite(mapBlock, clusterBlocks, map->mapLocs[i]);
+  }
+
+  free(mapBlock);
+  mapBlock = NULL;
+
+  //The map blocks before the base did not change, so the map still
+  //starts at the same place
+  if (map->base == 0) {
+    map->head = needed ? map->mapLocs[0] : 0;
+  }
+
+  map->dirty = 0;
+  return map->head;
+}
+
+//Returns the location of the last map block (0 if the file has no blocks)
+int mapTail(blockMap* map) {
+  return map->numMapLocs ? map->mapLocs[map->numMapLocs - 1] : 0;
+}
+
+//Returns the volume block holding logical block idx (0 if there is none)
+int mapGet(blockMap* map, int idx) {
+  if (idx < 0 || idx >= map->numBlocks) {
+    return 0;
+  }
+  if (idx < map->base) {
+    mapLoadHead(map);
+  }
+  return map->blocks[idx - map->base];
+}
+
+//Sets the volume block holding logical block idx, growing the map if needed
+void mapSet(blockMap* map, int idx, int block) {
+  if (idx < map->base) {
+    mapLoadHead(map);
+  }
+
+  mapReserve(map, idx + 1 - map->base);
+  map->blocks[idx - map->base] = block;
+  if (idx >= map->numBlocks) {
+    map->numBlocks = idx + 1;
+  }
+  map->dirty = 1;
+}
+
+//Returns a new map with the same entries as map that has not been
+//written to the disk yet
+blockMap* mapCopy(blockMap* map) {
+  mapLoadHead(map);
+
+  blockMap* copy = calloc(1, sizeof(blockMap));
+  if (!copy) {
+    mallocFailed();
+  }
+
+  mapReserve(copy, map->numBlocks);
+  memcpy(copy->blocks, map->blocks, map->numBlocks * sizeof(int));
+  copy->numBlocks = map->numBlocks;
+  copy->chunked = map->chunked;
+  copy->dirty = 1;
+
+  return copy;
+}
+
+//Returns the number of volume blocks the file uses, counting its map
+//blocks and not counting the holes in it
+int mapUsage(blockMap* map) {
+  mapLoadHead(map);
+
+  int used = map->numMapLocs;
+
+  //Each chunk of a compressed file uses as many clusters as it takes
+  //to hold its stored length
+  if (map->chunked) {
+    for (int i = 0; i + 1 < map->numBlocks; i += 2) {
+      if (map->blocks[i]) {
+        used += chunkClusters(map->blocks[i + 1]);
+      }
+    }
+    return used * clusterBlocks;
+  }
+
+  for (int i = 0; i < map->numBlocks; i++) {
+    if (map->blocks[i]) {
+      used++;
+    }
+  }
+
+  return used * clusterBlocks;
+}
+
+//Frees the data blocks of logical blocks numBlocks onwards and drops them
+//from the map (for a compressed file numBlocks counts entries, 2 a chunk)
+void mapTruncate(blockMap* map, int numBlocks) {
+  if (numBlocks >= map->numBlocks) {
+    return;
+  }
+  if (numBlocks < map->base) {
+    mapLoadHead(map);
+  }
+
+  int* blocks = map->blocks;
+  int base = map->base;
+
+  if (map->chunked) {
+    //Each chunk of a compressed file is its own run of clusters
+    for (int i = numBlocks; i + 1 < map->numBlocks; i += 2) {
+      if (blocks[i - base]) {
+        setBlocksAsFree(blocks[i - base],
+          chunkClusters(blocks[i + 1 - base]) * clusterBlocks);
+      }
+    }
+  } else {
+    //Free the data clusters a contiguous run at a time so that the bit
+    //vector is only updated once for every run
+    int i = numBlocks;
+    while (i < map->numBlocks) {
+      int start = blocks[i - base];
+      int run = 1;
+      while (i + run < map->numBlocks && start &&
+        blocks[i + run - base] == start + run * clusterBlocks) {
+        run++;
+      }
+      if (start) {
+        setBlocksAsFree(start, run * clusterBlocks);
+      }
+      i += run;
+    }
+  }
+
+  //The dropped entries read as holes if a later write past them grows the
+  //map again, instead of as the clusters that were just freed
+  memset(blocks + numBlocks - base, 0,
+    (map->numBlocks - numBlocks) * sizeof(int));
+
+  map->numBlocks = numBlocks;
+  map->dirty = 1;
+}
+
+//Frees every data block and map block used by the file and empties the map
+void mapRelease(blockMap* map) {
+  mapLoadHead(map);
+  mapTruncate(map, 0);
+
+  for (int j = 0; j < map->numMapLocs; j++) {
+    setBlocksAsFree(map->mapLocs[j], clusterBlocks);
+  }
+
+  if (map->blocks) {
+    memset(map->blocks, 0, map->capacity * sizeof(int));
+  }
+  map->numBlocks = 0;
+  map->numMapLocs = 0;
+  map->head = 0;
+  map->dirty = 1;
+}
+
+//Frees the memory used by the map
+void mapFree(blockMap* map) {
+  if (!map) {
+    return;
+  }
+  free(map->blocks);
+  map->blocks = NULL;
+  free(map->mapLocs);
+  map->mapLocs = NULL;
+  free(map);
+}
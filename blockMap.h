@@ -0,0 +1,108 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: blockMap.h
+*
+* Description: This file defines the block map of a file. The block
+* map records which volume block holds each logical block of a file.
+* It is stored out of band in a chain of map blocks so that the data
+* blocks of a file hold nothing but file bytes.
+*
+* The logical blocks of a file and the map blocks are each one cluster
+* (clusterSize bytes) long, and every entry is the number of the first
+* volume block of the cluster that holds the logical block.
+*
+* The map of a compressed file is its chunk index instead. Each chunk
+* of COMPRESS_CHUNK_SIZE bytes has a pair of entries: the first volume
+* block of the run of clusters holding the chunk, and the chunk's
+* stored length in bytes (negative if the chunk is stored raw).
+*
+**************************************************************/
+#ifndef BLOCKMAP_H
+#define BLOCKMAP_H
+
+#include "fs_commands.h"
+
+//Each map block starts with a header of 2 ints: the block number of the
+//next map block in the chain (0 if it is the last one) and the number of
+//entries stored in this map block
+#define MAP_HEADER_INTS 2
+
+//Number of bytes of a compressed file that are compressed together. A
+//volume with larger clusters compresses a cluster at a time instead.
+#define COMPRESS_CHUNK_SIZE (32 * 1024)
+
+typedef struct blockMap {
+  int* blocks;      //Volume block number of each logical block of the file,
+                    //starting with logical block base (0 = a hole that
+                    //has no block and reads as zeros)
+  int base;         //First logical block held in blocks (only more than 0
+                    //when just the tail of the map was read)
+  int numBlocks;    //Number of logical blocks in the file
+  int capacity;     //Number of entries that blocks has room for
+  int head;         //Block number of the first map block (0 = none)
+  int* mapLocs;     //Block numbers of the map blocks in memory
+  int numMapLocs;   //Number of map blocks in memory
+  int mapLocsCapacity; //Number of entries that mapLocs has room for
+  int dirty;        //1 if the map has changed since it was read
+  int chunked;      //1 if the map is the chunk index of a compressed file
+} blockMap;
+
+//Number of block numbers that fit in a single map block
+int entriesPerMapBlock();
+
+//Reads the block map whose first map block is at location (0 = empty file)
+blockMap* mapLoad(int location);
+
+//Reads the block map of the file of a directory entry
+blockMap* mapLoadEntry(dirEntry* entry);
+
+//Number of clusters a chunk of a compressed file takes up on the volume
+//given its stored length
+int chunkClusters(int storedLen);
+
+//Reads only the last map block of a file with numBlocks logical blocks,
+//which is all that is needed to add blocks to the end of the file
+blockMap* mapLoadTail(int location, int tailMap, int numBlocks);
+
+//Reads the part of the map before the map's base so that the whole map
+//is in memory
+void mapLoadHead(blockMap* map);
+
+//Writes the block map out to the disk and returns the location of its
+//first map block (0 if the file has no blocks)
+int mapSave(blockMap* map);
+
+//Returns the location of the last map block (0 if the file has no blocks)
+int mapTail(blockMap* map);
+
+//Returns the volume block holding logical block idx (0 if there is none)
+int mapGet(blockMap* map, int idx);
+
+//Sets the volume block holding logical block idx, growing the map if needed
+void mapSet(blockMap* map, int idx, int block);
+
+//Returns a new map with the same entries as map that has not been
+//written to the disk yet
+blockMap* mapCopy(blockMap* map);
+
+//Returns the number of volume blocks the file uses, counting its map
+//blocks and not counting the holes in it
+int mapUsage(blockMap* map);
+
+//Frees the data blocks of logical blocks numBlocks onwards and drops them
+//from the map (for a compressed file numBlocks counts entries, 2 a chunk)
+void mapTruncate(blockMap* map, int numBlocks);
+
+//Frees every data block and map block used by the file and empties the map
+void mapRelease(blockMap* map);
+
+//Frees the memory used by the map
+void mapFree(blockMap* map);
+
+#endif
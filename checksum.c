@@ -0,0 +1,104 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: checksum.c
+*
+* Description: This file holds the functions that keep the checksum
+* of every data cluster and check data against them.
+*
+**************************************************************/
+
+#include "checksum.h"
+#include "crc32c.h"
+#include "refTable.h"
+
+//CRC32C of each data cluster (uint32_t per cluster)
+diskTable sums = { NULL, 0, 0, -1, -1 };
+
+//Creates the checksum table of a new volume with numClusters clusters,
+//returning where it starts (-1 if there is no room for it)
+int checksumTableCreate(int numClusters) {
+  return createTable(tableBlocks(numClusters, sizeof(uint32_t)));
+}
+
+//Sets up the checksum table of a mounted volume (0 = the volume has none)
+void checksumTableInit(int location, int numClusters) {
+  sums.location = location;
+  sums.numBlocks = tableBlocks(numClusters, sizeof(uint32_t));
+  crc32cInit();
+}
+
+//Returns 1 if the data of this volume is checked against checksums
+int checksumsEnabled() {
+  return sums.location != 0;
+}
+
+//Records the checksums of numClusters clusters of data that were written
+//starting at block
+void setChecksums(char* data, int block, int numClusters) {
+  if (!sums.location) {
+    return;
+  }
+
+  uint32_t* clusterSums = (uint32_t*)tableData(&sums);
+  int first = block / clusterBlocks;
+  for (int i = 0; i < numClusters; i++) {
+    clusterSums[first + i] = crc32c(data + (size_t)i * clusterSize, clusterSize);
+  }
+
+  tableChanged(&sums, first, sizeof(uint32_t));
+  tableChanged(&sums, first + numClusters - 1, sizeof(uint32_t));
+}
+
+//Gives the numClusters clusters starting at block to the checksums of the
+//clusters starting at from, which hold the same data
+void copyChecksums(int from, int block, int numClusters) {
+  if (!sums.location) {
+    return;
+  }
+
+  uint32_t* clusterSums = (uint32_t*)tableData(&sums);
+  int first = block / clusterBlocks;
+  memmove(clusterSums + first, clusterSums + from / clusterBlocks,
+    numClusters * sizeof(uint32_t));
+
+  tableChanged(&sums, first, sizeof(uint32_t));
+  tableChanged(&sums, first + numClusters - 1, sizeof(uint32_t));
+}
+
+//Returns 1 if numClusters clusters of data that were read starting at
+//block match their checksums (always 1 if the volume has none)
+int checksumsMatch(char* data, int block, int numClusters) {
+  if (!sums.location) {
+    return 1;
+  }
+
+  uint32_t* clusterSums = (uint32_t*)tableData(&sums);
+  int first = block / clusterBlocks;
+  for (int i = 0; i < numClusters; i++) {
+    if (clusterSums[first + i] !=
+      crc32c(data + (size_t)i * clusterSize, clusterSize)) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+//Reads the checksum table into memory, after which more than one thread
+//can check data against it at once
+void loadChecksumTable() {
+  if (sums.location) {
+    tableData(&sums);
+  }
+}
+
+//Writes the parts of the checksum table that changed out to the disk
+void writeChecksumTable() {
+  writeTable(&sums);
+}
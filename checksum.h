@@ -0,0 +1,51 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: checksum.h
+*
+* Description: This file holds the prototypes of the functions that
+* keep the checksum table. The table holds the CRC32C of every data
+* cluster of every file, kept apart from the data, so that data that
+* was damaged on the disk is caught when it is read.
+*
+**************************************************************/
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include "fs_commands.h"
+
+//Creates the checksum table of a new volume with numClusters clusters,
+//returning where it starts (-1 if there is no room for it)
+int checksumTableCreate(int numClusters);
+
+//Sets up the checksum table of a mounted volume (0 = the volume has none)
+void checksumTableInit(int location, int numClusters);
+
+//Returns 1 if the data of this volume is checked against checksums
+int checksumsEnabled();
+
+//Records the checksums of numClusters clusters of data that were written
+//starting at block
+void setChecksums(char* data, int block, int numClusters);
+
+//Gives the numClusters clusters starting at block to the checksums of the
+//clusters starting at from, which hold the same data
+void copyChecksums(int from, int block, int numClusters);
+
+//Returns 1 if numClusters clusters of data that were read starting at
+//block match their checksums (always 1 if the volume has none)
+int checksumsMatch(char* data, int block, int numClusters);
+
+//Reads the checksum table into memory, after which more than one thread
+//can check data against it at once
+void loadChecksumTable();
+
+//Writes the parts of the checksum table that changed out to the disk
+void writeChecksumTable();
+
+#endif
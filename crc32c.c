@@ -0,0 +1,150 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: crc32c.c
+*
+* Description: This file holds the CRC32C (Castagnoli) checksum used
+* to check the data of files. Without CRC32C instructions the checksum
+* is computed 8 bytes at a time with 8 lookup tables (slicing-by-8).
+*
+**************************************************************/
+
+#include <string.h>
+#include "crc32c.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+#define CRC32C_POLY 0x82F63B78  //Castagnoli polynomial, bit reversed
+
+//crcTables[0] is the usual byte at a time table, crcTables[k] gives the
+//CRC of a byte followed by k zero bytes
+uint32_t crcTables[8][256];
+
+//The function crc32c() uses, picked by crc32cInit()
+uint32_t (*crcUpdate)(uint32_t crc, const unsigned char* data, size_t len) = NULL;
+
+//Updates crc with len bytes of data using the lookup tables
+uint32_t crcUpdateTables(uint32_t crc, const unsigned char* data, size_t len) {
+  while (len >= 8) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    word ^= crc;    //the tables assume a little endian processor
+    crc = crcTables[7][word & 0xFF] ^
+      crcTables[6][(word >> 8) & 0xFF] ^
+      crcTables[5][(word >> 16) & 0xFF] ^
+      crcTables[4][(word >> 24) & 0xFF] ^
+      crcTables[3][(word >> 32) & 0xFF] ^
+      crcTables[2][(word >> 40) & 0xFF] ^
+      crcTables[1][(word >> 48) & 0xFF] ^
+      crcTables[0][word >> 56];
+    data += 8;
+    len -= 8;
+  }
+
+  while (len > 0) {
+    crc = crcTables[0][(crc ^ *data) & 0xFF] ^ (crc >> 8);
+    data++;
+    len--;
+  }
+
+  return crc;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+//Updates crc with len bytes of data using the SSE4.2 crc32 instruction
+__attribute__((target("sse4.2")))
+uint32_t crcUpdateSse42(uint32_t crc, const unsigned char* data, size_t len) {
+#if defined(__x86_64__)
+  uint64_t crc64 = crc;
+  while (len >= 8) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+    data += 8;
+    len -= 8;
+  }
+  crc = crc64;
+#endif
+
+  while (len > 0) {
+    crc = _mm_crc32_u8(crc, *data);
+    data++;
+    len--;
+  }
+
+  return crc;
+}
+#elif defined(__aarch64__)
+//Updates crc with len bytes of data using the ARMv8 crc32c instructions
+__attribute__((target("+crc")))
+uint32_t crcUpdateArm(uint32_t crc, const unsigned char* data, size_t len) {
+  while (len >= 8) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    crc = __crc32cd(crc, word);
+    data += 8;
+    len -= 8;
+  }
+
+  while (len > 0) {
+    crc = __crc32cb(crc, *data);
+    data++;
+    len--;
+  }
+
+  return crc;
+}
+#endif
+
+//Picks the fastest way to compute checksums on this processor. It must
+//be called before crc32c() is used by more than one thread.
+void crc32cInit() {
+  if (crcUpdate) {
+    return;
+  }
+
+  for (int i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+    }
+    crcTables[0][i] = crc;
+  }
+  for (int i = 0; i < 256; i++) {
+    for (int k = 1; k < 8; k++) {
+      uint32_t prev = crcTables[k - 1][i];
+      crcTables[k][i] = crcTables[0][prev & 0xFF] ^ (prev >> 8);
+    }
+  }
+
+  crcUpdate = crcUpdateTables;
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_supports("sse4.2")) {
+    crcUpdate = crcUpdateSse42;
+  }
+#elif defined(__aarch64__)
+  if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+    crcUpdate = crcUpdateArm;
+  }
+#endif
+}
+
+//Returns the CRC32C of len bytes of data
+uint32_t crc32c(const void* data, size_t len) {
+  if (!crcUpdate) {
+    crc32cInit();
+  }
+
+  return crcUpdate(0xFFFFFFFF, data, len) ^ 0xFFFFFFFF;
+}
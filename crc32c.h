@@ -0,0 +1,30 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: crc32c.h
+*
+* Description: This file holds the prototypes of the CRC32C
+* (Castagnoli) checksum used to check the data of files. The CRC32C
+* instructions of SSE4.2 or ARMv8 are used when the processor has
+* them, otherwise the checksum is computed with lookup tables.
+*
+**************************************************************/
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Picks the fastest way to compute checksums on this processor. It must
+//be called before crc32c() is used by more than one thread.
+void crc32cInit();
+
+//Returns the CRC32C of len bytes of data
+uint32_t crc32c(const void* data, size_t len);
+
+#endif
@@ -0,0 +1,447 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: defrag.c
+*
+* Description: This file holds the defragmenter. A fragmented file
+* gets new runs of clusters, its data is copied into them with large
+* reads and writes, and a new block map is written for it. Only then
+* is its directory entry changed to point at the new map, after which
+* the old clusters and map blocks are freed, so the file holds either
+* all old or all new data if the defrag is stopped partway. The volume
+* lock is only held for a piece of the copy at a time, so the volume can
+* be used while a file is moved, and a file that is opened or changed
+* meanwhile is left where it was.
+*
+**************************************************************/
+
+#include <time.h>
+#include <pthread.h>
+#include "defrag.h"
+#include "blockMap.h"
+#include "b_io.h"
+#include "refTable.h"
+#include "checksum.h"
+#include "snapshot.h"
+#include "segment.h"
+
+#define DEFRAG_IO_SIZE (4 * 1024 * 1024)  //Most bytes copied at once
+
+typedef struct defragState {
+  long bytesPerSecond;    //Most bytes moved a second (0 = no limit)
+  struct timespec start;  //When the defrag started
+  long bytesMoved;
+  int filesChecked;
+  int filesMoved;
+} defragState;
+
+//Held while a defrag runs, since only one file can be watched at a time
+pthread_mutex_t defragLock = PTHREAD_MUTEX_INITIALIZER;
+
+//Waits until moving the bytes moved so far has taken as long as the rate
+//limit allows
+void defragThrottle(defragState* state) {
+  if (state->bytesPerSecond <= 0) {
+    return;
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  double elapsed = (now.tv_sec - state->start.tv_sec) +
+    (now.tv_nsec - state->start.tv_nsec) / 1e9;
+  double due = (double)state->bytesMoved / state->bytesPerSecond;
+
+  if (due > elapsed) {
+    double wait = due - elapsed;
+    struct timespec pause;
+    pause.tv_sec = (time_t)wait;
+    pause.tv_nsec = (long)((wait - pause.tv_sec) * 1e9);
+    nanosleep(&pause, NULL);
+  }
+}
+
+//Returns the number of runs of contiguous clusters that hold the data of
+//a file, or -1 if any of its clusters is shared with another file
+int countExtents(blockMap* map, int* numClusters) {
+  int extents = 0;
+  int prev = 0;     //Previous data cluster of the file (0 = none yet)
+  *numClusters = 0;
+
+  for (int i = 0; i < map->numBlocks; i++) {
+    int block = map->blocks[i];
+    if (!block) {
+      continue;
+    }
+    if (isShared(block)) {
+      return -1;
+    }
+
+    //A cluster starts a new run unless it follows the previous data
+    //cluster of the file on the volume, holes aside
+    if (!prev || prev + clusterBlocks != block) {
+      extents++;
+    }
+    prev = block;
+    (*numClusters)++;
+  }
+
+  return extents;
+}
+
+//Copies the data of a file into the new runs in order, filling in the
+//new map as it goes. The volume lock is held for each piece but not
+//while waiting for the rate limit. It returns 1 if the data was copied,
+//or 0 if the file was opened before the copy was done.
+int copyIntoRuns(blockMap* map, blockMap* newMap, off_t fileSize,
+  int* runStart, int* runLength, int numRuns, defragState* state) {
+  int bufClusters = DEFRAG_IO_SIZE / clusterSize;
+  if (bufClusters < 1) {
+    bufClusters = 1;
+  }
+  char* data = malloc((size_t)bufClusters * clusterSize);
+  if (!data) {
+    mallocFailed();
+  }
+
+  int lb = 0;   //Next logical block of the file to be copied
+  for (int r = 0; r < numRuns; r++) {
+    int placed = 0;
+    while (placed < runLength[r]) {
+      int piece = runLength[r] - placed;
+      if (piece > bufClusters) {
+        piece = bufClusters;
+      }
+      int dest = runStart[r] + placed * clusterBlocks;
+
+      lockVolume(1);
+      if (watchedFileOpened()) {
+        unlockVolume();
+        free(data);
+        data = NULL;
+        return 0;
+      }
+
+      //Clusters that are already next to each other are read together
+      int filled = 0;
+      while (filled < piece) {
+        while (!map->blocks[lb]) {
+          lb++;     //holes stay holes
+        }
+
+        int old = map->blocks[lb];
+        int seq = 1;
+        while (filled + seq < piece && lb + seq < map->numBlocks &&
+          map->blocks[lb + seq] == old + seq * clusterBlocks) {
+          seq++;
+        }
+
+        segmentRead(data + (size_t)filled * clusterSize, seq * clusterBlocks,
+          old);
+        int newBlock = dest + filled * clusterBlocks;
+        copyChecksums(old, newBlock, seq);
+
+        for (int i = 0; i < seq; i++) {
+          mapSet(newMap, lb + i, newBlock + i * clusterBlocks);
+
+          //Only full clusters are hashed for dedup
+          if (dedupEnabled() &&
+            (off_t)(lb + i + 1) * clusterSize <= fileSize) {
+            setClusterHash(newBlock + i * clusterBlocks,
+              clusterHash(data + (size_t)(filled + i) * clusterSize));
+          }
+        }
+
+        lb += seq;
+        filled += seq;
+      }
+
+      deviceWrite(data, piece * clusterBlocks, dest);
+      unlockVolume();
+      placed += piece;
+
+      state->bytesMoved += (long)piece * clusterSize;
+      defragThrottle(state);
+    }
+  }
+
+  free(data);
+  data = NULL;
+  return 1;
+}
+
+//Frees the new runs of a file that is not moved after all
+void releaseRuns(int* runStart, int* runLength, int numRuns) {
+  for (int r = 0; r < numRuns; r++) {
+    setBlocksAsFree(runStart[r], runLength[r] * clusterBlocks);
+  }
+  writeFreeSpace();
+}
+
+//Returns 1 if the directory at path is still the one at location
+int dirIsAt(char* path, int location) {
+  hashTable* dir = getDir(path);
+  if (!dir) {
+    return 0;
+  }
+  int same = dir->location == location;
+  clean(dir);
+  dir = NULL;
+  return same;
+}
+
+//Returns 1 if the file called name in the directory at dirLocation, whose
+//path is path, still has the directory entry it had when its move began
+//and none of its clusters have become shared, so the moved copy can take
+//its place
+int fileUnchanged(char* path, int dirLocation, char* name, dirEntry* was) {
+  if (!dirIsAt(path, dirLocation) || fileIsOpen(dirLocation, name) ||
+    watchedFileOpened()) {
+    return 0;
+  }
+
+  hashTable* dir = readTableData(dirLocation);
+  dirEntry* entry = getEntry(name, dir);
+  int same = entry && !entry->isDir && !entry->compressed &&
+    entry->location == was->location && entry->tailMap == was->tailMap &&
+    entry->fileSize == was->fileSize &&
+    entry->dateModified == was->dateModified;
+  clean(dir);
+  dir = NULL;
+  if (!same) {
+    return 0;
+  }
+
+  //A snapshot or reflink taken meanwhile shares the file's clusters
+  blockMap* map = mapLoadEntry(was);
+  int numClusters;
+  same = countExtents(map, &numClusters) >= 0;
+  mapFree(map);
+  map = NULL;
+  return same;
+}
+
+//Moves the data of the file called name in the directory at dirLocation,
+//whose path is path, into fewer runs of clusters, returning 1 if it was
+//moved
+int defragFile(char* path, int dirLocation, char* name,
+  defragState* state) {
+  lockVolume(1);
+  if (!dirIsAt(path, dirLocation) || fileIsOpen(dirLocation, name)) {
+    unlockVolume();
+    return 0;
+  }
+
+  hashTable* dir = readTableData(dirLocation);
+  dirEntry* entry = getEntry(name, dir);
+  if (!entry || entry->isDir || entry->compressed || !entry->location) {
+    clean(dir);
+    dir = NULL;
+    unlockVolume();
+    return 0;
+  }
+
+  //The entry is kept to check that the file is unchanged once its data
+  //has been copied
+  dirEntry was = *entry;
+  off_t fileSize = entry->fileSize;
+  blockMap* map = mapLoadEntry(entry);
+  clean(dir);
+  dir = NULL;
+
+  int numClusters;
+  int extents = countExtents(map, &numClusters);
+  if (extents <= 1) {
+    mapFree(map);
+    map = NULL;
+    unlockVolume();
+    return 0;
+  }
+
+  //The file is only moved if its data ends up in fewer runs than now
+  int* runStart = malloc(extents * sizeof(int));
+  int* runLength = malloc(extents * sizeof(int));
+  if (!runStart || !runLength) {
+    mallocFailed();
+  }
+
+  int numRuns = 0;
+  int remaining = numClusters;
+  while (remaining > 0 && numRuns < extents - 1) {
+    int runBlocks;
+    int freeBlock = getFreeRun(remaining * clusterBlocks, &runBlocks);
+    // Check if the freeBlock returned is valid or not
+    if (freeBlock < 0) {
+      break;
+    }
+    setBlocksAsAllocated(freeBlock, runBlocks);
+    runStart[numRuns] = freeBlock;
+    runLength[numRuns] = runBlocks / clusterBlocks;
+    numRuns++;
+    remaining -= runBlocks / clusterBlocks;
+  }
+
+  if (remaining > 0) {
+    releaseRuns(runStart, runLength, numRuns);
+    free(runStart);
+    runStart = NULL;
+    free(runLength);
+    runLength = NULL;
+    mapFree(map);
+    map = NULL;
+    unlockVolume();
+    return 0;
+  }
+
+  //The data is copied without holding the volume lock throughout, so the
+  //file may be opened, changed, or removed meanwhile
+  watchOpens(dirLocation, name);
+  unlockVolume();
+
+  blockMap* newMap = mapCopy(map);
+  int copied = copyIntoRuns(map, newMap, fileSize, runStart, runLength,
+    numRuns, state);
+
+  lockVolume(1);
+  if (!copied || !fileUnchanged(path, dirLocation, name, &was)) {
+    watchOpens(-1, "");
+    releaseRuns(runStart, runLength, numRuns);
+    free(runStart);
+    runStart = NULL;
+    free(runLength);
+    runLength = NULL;
+    mapFree(map);
+    map = NULL;
+    mapFree(newMap);
+    newMap = NULL;
+    unlockVolume();
+    return 0;
+  }
+  watchOpens(-1, "");
+
+  //The new map and the clusters it uses are on the disk before the
+  //directory entry points at them
+  int location = mapSave(newMap);
+  int tailMap = mapTail(newMap);
+  writeFreeSpace();
+
+  dir = readTableData(dirLocation);
+  entry = getEntry(name, dir);
+  entry->location = location;
+  entry->tailMap = tailMap;
+  writeTableData(dir, dirLocation);
+  dir = NULL;
+
+  mapRelease(map);
+  writeFreeSpace();
+
+  mapFree(map);
+  map = NULL;
+  mapFree(newMap);
+  newMap = NULL;
+  free(runStart);
+  runStart = NULL;
+  free(runLength);
+  runLength = NULL;
+  unlockVolume();
+
+  return 1;
+}
+
+//Defragments every file in the directory at location, whose path is
+//path, and the directories under it, leaving out the snapshots. The
+//entries are read in first, since the directory can change while its
+//files are moved.
+void defragDir(char* path, int location, int snapshots,
+  defragState* state) {
+  lockVolume(1);
+  if (!dirIsAt(path, location)) {
+    unlockVolume();
+    return;
+  }
+  hashTable* dir = readTableData(location);
+
+  int numEntries = 0;
+  for (int i = 0; i < SIZE; i++) {
+    for (node* n = dir->entries[i]; n != NULL; n = n->next) {
+      numEntries++;
+    }
+  }
+  dirEntry* entries = malloc((numEntries + 1) * sizeof(dirEntry));
+  if (!entries) {
+    mallocFailed();
+  }
+  numEntries = 0;
+  for (int i = 0; i < SIZE; i++) {
+    for (node* n = dir->entries[i]; n != NULL; n = n->next) {
+      entries[numEntries++] = *(dirEntry*)n->value;
+    }
+  }
+
+  clean(dir);
+  dir = NULL;
+  unlockVolume();
+
+  for (int i = 0; i < numEntries; i++) {
+    dirEntry* entry = &entries[i];
+    if (strcmp(entry->filename, "") == 0 ||
+      strcmp(entry->filename, ".") == 0 ||
+      strcmp(entry->filename, "..") == 0) {
+      continue;
+    }
+
+    if (entry->isDir) {
+      if (entry->location != snapshots) {
+        char* childPath = malloc(strlen(path) + strlen(entry->filename) + 2);
+        if (!childPath) {
+          mallocFailed();
+        }
+        sprintf(childPath, "%s%s/", path, entry->filename);
+        defragDir(childPath, entry->location, snapshots, state);
+        free(childPath);
+        childPath = NULL;
+      }
+    } else {
+      state->filesChecked++;
+      state->filesMoved += defragFile(path, location, entry->filename, state);
+    }
+  }
+
+  free(entries);
+  entries = NULL;
+}
+
+//Moves the data of every fragmented file into fewer runs, moving no more
+//than bytesPerSecond bytes a second (0 = as fast as it can). Files that
+//are open, compressed, or share clusters with other files are left as
+//they are. It returns the number of files that were moved.
+int fs_defrag(long bytesPerSecond) {
+  defragState state;
+  memset(&state, 0, sizeof(state));
+  state.bytesPerSecond = bytesPerSecond;
+  clock_gettime(CLOCK_MONOTONIC, &state.start);
+
+  pthread_mutex_lock(&defragLock);
+
+  lockVolume(1);
+  hashTable* root = getDir("/");
+  int rootLocation = root->location;
+  clean(root);
+  root = NULL;
+  int snapshots = snapshotsLocation();
+  unlockVolume();
+
+  //Every file in a snapshot shares its clusters, so none can be moved
+  defragDir("/", rootLocation, snapshots, &state);
+
+  printf("Defragmented %d of %d files, moved %ld clusters\n",
+    state.filesMoved, state.filesChecked, state.bytesMoved / clusterSize);
+
+  pthread_mutex_unlock(&defragLock);
+
+  return state.filesMoved;
+}
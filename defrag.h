@@ -0,0 +1,28 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: defrag.h
+*
+* Description: This file holds the prototype of the defragmenter,
+* which moves the data of files that are spread over many runs of
+* clusters into as few contiguous runs as it can while the volume
+* is in use.
+*
+**************************************************************/
+#ifndef DEFRAG_H
+#define DEFRAG_H
+
+#include "fs_commands.h"
+
+//Moves the data of every fragmented file into fewer runs, moving no more
+//than bytesPerSecond bytes a second (0 = as fast as it can). Files that
+//are open, compressed, or share clusters with other files are left as
+//they are. It returns the number of files that were moved.
+int fs_defrag(long bytesPerSecond);
+
+#endif
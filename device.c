@@ -0,0 +1,1359 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: device.c
+*
+* Description: This file holds the functions the file system reads
+* and writes the volume's blocks with. The volume file opened by
+* startPartitionSystem is read and written with LBAread and LBAwrite.
+* Any other volume file is a plain file of blocks that is read and
+* written directly.
+*
+* A striped volume is split into stripe units that go to its volume
+* files in turn. The pieces of a request that go to different volume
+* files are read or written at the same time, with a thread for each
+* volume file.
+*
+* A mirrored volume writes every block to both its volume files at the
+* same time. Reads go to the copy with the fewest requests being done on
+* it, or the one last used nearest the blocks, and large reads are split
+* between both copies. The mirror table records which regions of each
+* copy are out of date, so a resync only copies those regions.
+*
+* A parity volume is striped like a striped volume, but one unit of each
+* stripe holds the XOR of the others, and which volume file holds it
+* rotates from stripe to stripe. The blocks of one volume file that is
+* missing or fails are rebuilt from the rest of their stripe.
+*
+* Requests can come from more than one thread. LBAread and LBAwrite are
+* not safe to call from two threads at once, so they are called one at a
+* time. A tiered or parity volume keeps state about the volume (tier heat,
+* a held back stripe) and does one request at a time. A mirrored volume
+* only holds its state while it picks a copy and updates the mirror
+* table, so reads from both copies run side by side, while its writes
+* are made one at a time so that both copies get them in the same order.
+* Requests to a single or striped volume otherwise run side by side.
+*
+**************************************************************/
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "device.h"
+#include "tier.h"
+#include "xor.h"
+
+//A volume file the volume is made up of
+typedef struct volumeFile {
+  int fd;               //The open file (-1 = the startPartitionSystem file)
+  uint64_t numBlocks;   //Number of blocks in the file
+} volumeFile;
+
+//The part of a request that goes to one volume file
+typedef struct deviceJob {
+  int file;             //Index of the volume file in volumeFiles
+  char* buffer;         //The caller's buffer for the whole request
+  uint64_t count;       //Blocks in the whole request
+  uint64_t position;    //First block of the whole request
+  int write;            //1 to write the blocks, 0 to read them
+  uint64_t done;        //Blocks of this volume file's part that were done
+} deviceJob;
+
+int deviceLayout = DEVICE_SINGLE;
+uint64_t deviceBlockSize = 0;
+
+//The first volume file is always the one opened by startPartitionSystem.
+//A tiered volume has the fast volume file first and the slow one second.
+volumeFile volumeFiles[DEVICE_MAX_FILES] = { { -1, 0 } };
+int numVolumeFiles = 1;
+uint64_t stripeBlocks = 0;    //Blocks in each stripe unit
+
+//The start of the mirror table of a mirrored volume
+typedef struct mirrorHeader {
+  unsigned int signature;   //MIRROR_SIG once the table has been written
+  unsigned int volumeId;    //The same in both volume files of a volume
+} mirrorHeader;
+
+char* mirrorTable = NULL;       //The header, then the state of each region
+uint64_t mirrorTableBlocks = 0; //Number of blocks the table takes up
+uint64_t mirrorTableStart = 0;  //Block of the volume files the table is at
+uint64_t mirrorRegions = 0;     //Number of regions in the volume
+
+//The header in the last stripe unit of each volume file of a parity
+//volume
+typedef struct parityHeader {
+  unsigned int signature;   //PARITY_SIG once the header has been written
+  unsigned int volumeId;    //The same in every volume file of a volume
+  int file;                 //Index of the volume file in the volume
+  int failedFile;           //Volume file that is out of date (-1 = none)
+} parityHeader;
+
+unsigned int parityVolumeId = 0;
+uint64_t parityRows = 0;   //Number of stripes in the volume
+int failedFile = -1;       //Volume file of a parity volume that is missing
+                           //or out of date (-1 = none)
+
+//Data written to part of a stripe of a parity volume, which is held back
+//in case the rest of the stripe is written next
+char* pendingData = NULL;           //The data units of the stripe
+unsigned char* pendingValid = NULL; //1 for each block that was written
+int64_t pendingRow = -1;            //The stripe (-1 = none)
+
+//Requests being done on each copy, and the block after the last one read
+//from it, used to pick the copy a read goes to (both only used while
+//deviceLock is held)
+int pendingIO[DEVICE_MAX_FILES] = { 0 };
+uint64_t lastBlock[DEVICE_MAX_FILES] = { 0 };
+
+pthread_mutex_t lbaLock = PTHREAD_MUTEX_INITIALIZER;     //Held for LBAread
+                                                         //and LBAwrite
+pthread_mutex_t deviceLock = PTHREAD_MUTEX_INITIALIZER;  //Held while the
+                                                         //layout's state is
+                                                         //used
+
+//Opens a volume file of plain blocks, creating it with numBlocks blocks
+//if it does not exist, otherwise setting numBlocks to its size
+int openVolumeFile(char* filename, uint64_t* numBlocks, uint64_t blockSize) {
+  int fd = open(filename, O_RDWR);
+  if (fd < 0 && errno == ENOENT) {
+    fd = open(filename, O_RDWR | O_CREAT, 0666);
+    if (fd >= 0 && ftruncate(fd, *numBlocks * blockSize) < 0) {
+      close(fd);
+      fd = -1;
+    }
+    return fd;
+  }
+  if (fd < 0) {
+    return -1;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) < 0) {
+    close(fd);
+    return -1;
+  }
+  *numBlocks = info.st_size / blockSize;
+  return fd;
+}
+
+//Adds a volume file to the volume, returning 0 on success and -1 if it
+//could not be opened (see openVolumeFile for numBlocks)
+int addVolumeFile(char* filename, uint64_t* numBlocks, uint64_t blockSize) {
+  if (numVolumeFiles == DEVICE_MAX_FILES) {
+    printf("Error: a volume can have at most %d volume files\n",
+      DEVICE_MAX_FILES);
+    return -1;
+  }
+
+  int fd = openVolumeFile(filename, numBlocks, blockSize);
+  if (fd < 0) {
+    printf("Error: could not open the volume file %s\n", filename);
+    return -1;
+  }
+
+  volumeFiles[numVolumeFiles].fd = fd;
+  volumeFiles[numVolumeFiles].numBlocks = *numBlocks;
+  numVolumeFiles++;
+  deviceBlockSize = blockSize;
+  return 0;
+}
+
+//Adds a slow volume file to the fast one opened by startPartitionSystem,
+//which holds numFastBlocks blocks. The slow file is created with
+//numBlocks blocks if it does not exist, otherwise numBlocks is set to its
+//size. It returns 0 on success and -1 if the file could not be opened.
+int deviceAddSlowTier(char* filename, uint64_t* numBlocks,
+  uint64_t numFastBlocks, uint64_t blockSize) {
+  volumeFiles[0].numBlocks = numFastBlocks;
+  if (addVolumeFile(filename, numBlocks, blockSize) < 0) {
+    return -1;
+  }
+
+  deviceLayout = DEVICE_TIERED;
+  return 0;
+}
+
+//Stripes the volume across the volume file opened by startPartitionSystem,
+//which holds fileBlocks blocks, and the numFiles volume files in
+//filenames, with unitBlocks blocks in each stripe unit. Volume files that
+//do not exist are created with fileBlocks blocks. It stores the number of
+//blocks in the volume in numBlocks and returns 0 on success and -1 if a
+//file could not be opened.
+int deviceAddStripes(char** filenames, int numFiles, uint64_t fileBlocks,
+  uint64_t blockSize, uint64_t unitBlocks, uint64_t* numBlocks) {
+  volumeFiles[0].numBlocks = fileBlocks;
+
+  //Every volume file holds the same number of whole stripe units, so the
+  //smallest one sets how many that is
+  uint64_t smallest = fileBlocks;
+  for (int i = 0; i < numFiles; i++) {
+    uint64_t blocks = fileBlocks;
+    if (addVolumeFile(filenames[i], &blocks, blockSize) < 0) {
+      return -1;
+    }
+    if (blocks < smallest) {
+      smallest = blocks;
+    }
+  }
+
+  deviceLayout = DEVICE_STRIPED;
+  stripeBlocks = unitBlocks;
+  *numBlocks = smallest / unitBlocks * unitBlocks * numVolumeFiles;
+  return 0;
+}
+
+//Reads or writes count blocks of a volume file starting at its block
+//position, returning the number of blocks done
+uint64_t fileIO(int file, char* buffer, uint64_t count, uint64_t position,
+  int write) {
+  if (volumeFiles[file].fd < 0) {
+    pthread_mutex_lock(&lbaLock);
+    uint64_t done = write ? LBAwrite(buffer, count, position) :
+      LBAread(buffer, count, position);
+    pthread_mutex_unlock(&lbaLock);
+    return done;
+  }
+
+  size_t total = count * deviceBlockSize;
+  off_t offset = position * deviceBlockSize;
+  size_t done = 0;
+
+  while (done < total) {
+    ssize_t n = write ?
+      pwrite(volumeFiles[file].fd, buffer + done, total - done, offset + done) :
+      pread(volumeFiles[file].fd, buffer + done, total - done, offset + done);
+    if (n <= 0) {
+      break;
+    }
+    done += n;
+  }
+
+  return done / deviceBlockSize;
+}
+
+//Returns the state of a region of a mirrored volume
+unsigned char* mirrorRegion(uint64_t region) {
+  return (unsigned char*)mirrorTable + sizeof(mirrorHeader) + region;
+}
+
+//Mirrors the volume file opened by startPartitionSystem, which holds
+//fileBlocks blocks, onto the volume file filename, which is created with
+//fileBlocks blocks if it does not exist. It stores the number of blocks
+//in the volume in numBlocks and returns 0 on success and -1 if the mirror
+//could not be opened.
+int deviceAddMirror(char* filename, uint64_t fileBlocks, uint64_t blockSize,
+  uint64_t* numBlocks) {
+  volumeFiles[0].numBlocks = fileBlocks;
+  uint64_t mirrorBlocks = fileBlocks;
+  if (addVolumeFile(filename, &mirrorBlocks, blockSize) < 0) {
+    return -1;
+  }
+
+  //The table goes in the last blocks of the smaller volume file
+  uint64_t blocks = mirrorBlocks < fileBlocks ? mirrorBlocks : fileBlocks;
+  uint64_t tableBytes = sizeof(mirrorHeader) +
+    (blocks + MIRROR_REGION_BLOCKS - 1) / MIRROR_REGION_BLOCKS;
+  mirrorTableBlocks = (tableBytes + blockSize - 1) / blockSize;
+  mirrorTableStart = blocks - mirrorTableBlocks;
+  mirrorRegions = (mirrorTableStart + MIRROR_REGION_BLOCKS - 1) /
+    MIRROR_REGION_BLOCKS;
+
+  mirrorTable = calloc(mirrorTableBlocks, blockSize);
+  char* otherTable = calloc(mirrorTableBlocks, blockSize);
+  if (!mirrorTable || !otherTable) {
+    mallocFailed();
+  }
+
+  mirrorHeader* header = (mirrorHeader*)mirrorTable;
+  mirrorHeader* otherHeader = (mirrorHeader*)otherTable;
+  int valid = fileIO(0, mirrorTable, mirrorTableBlocks, mirrorTableStart,
+    0) == mirrorTableBlocks && header->signature == MIRROR_SIG;
+  int otherValid = fileIO(1, otherTable, mirrorTableBlocks,
+    mirrorTableStart, 0) == mirrorTableBlocks &&
+    otherHeader->signature == MIRROR_SIG;
+
+  if (valid && otherValid && header->volumeId == otherHeader->volumeId) {
+    //Both tables are written together, but a write may have only made
+    //it to one of them
+    for (uint64_t r = 0; r < mirrorRegions; r++) {
+      *mirrorRegion(r) |= otherTable[sizeof(mirrorHeader) + r];
+    }
+  } else if (otherValid && !valid) {
+    //The volume file opened by startPartitionSystem is new, so the volume
+    //is only on the mirror
+    memcpy(mirrorTable, otherTable, mirrorTableBlocks * blockSize);
+    for (uint64_t r = 0; r < mirrorRegions; r++) {
+      *mirrorRegion(r) = (*mirrorRegion(r) & ~2) | 1;
+    }
+  } else {
+    //The mirror is new or is the mirror of another volume. The table is
+    //only written once the volume is, since the volume file may not be
+    //a mirrored volume at all.
+    if (!valid) {
+      memset(mirrorTable, 0, mirrorTableBlocks * blockSize);
+      header->signature = MIRROR_SIG;
+      header->volumeId = (unsigned int)time(NULL) ^ (unsigned int)getpid();
+    }
+    for (uint64_t r = 0; r < mirrorRegions; r++) {
+      *mirrorRegion(r) = (*mirrorRegion(r) & ~1) | 2;
+    }
+  }
+
+  //Regions being written when the volume was last used may differ if it
+  //was not closed, so the mirror's copy is taken to be out of date
+  for (uint64_t r = 0; r < mirrorRegions; r++) {
+    unsigned char* state = mirrorRegion(r);
+    if (*state & MIRROR_WRITTEN) {
+      *state &= ~MIRROR_WRITTEN;
+      if (!(*state & 1)) {
+        *state |= 2;
+      }
+    }
+  }
+
+  free(otherTable);
+  otherTable = NULL;
+
+  deviceLayout = DEVICE_MIRRORED;
+  *numBlocks = mirrorTableStart;
+  return 0;
+}
+
+//Writes the mirror table to both volume files
+void writeMirrorTable() {
+  for (int i = 0; i < 2; i++) {
+    fileIO(i, mirrorTable, mirrorTableBlocks, mirrorTableStart, 1);
+  }
+}
+
+//Sets the bits in the state of the regions holding count blocks starting
+//at position, writing out the table if that changed it
+void mirrorMark(uint64_t position, uint64_t count, unsigned char bits) {
+  int changed = 0;
+  uint64_t last = (position + count - 1) / MIRROR_REGION_BLOCKS;
+  for (uint64_t r = position / MIRROR_REGION_BLOCKS; r <= last; r++) {
+    unsigned char* state = mirrorRegion(r);
+    if ((*state & bits) != bits) {
+      *state |= bits;
+      changed = 1;
+    }
+  }
+
+  if (changed) {
+    writeMirrorTable();
+  }
+}
+
+//Returns 1 if the copy on volume file file of the count blocks starting
+//at position is up to date, otherwise 0
+int mirrorUpToDate(int file, uint64_t position, uint64_t count) {
+  uint64_t last = (position + count - 1) / MIRROR_REGION_BLOCKS;
+  for (uint64_t r = position / MIRROR_REGION_BLOCKS; r <= last; r++) {
+    if (*mirrorRegion(r) & (1 << file)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+//Reads or writes blocks of a tiered volume, sending the blocks of the
+//fast tier to the fast volume file and the rest to the slow one
+uint64_t tieredIO(char* buffer, uint64_t count, uint64_t position, int write) {
+  uint64_t fastBlocks = volumeFiles[0].numBlocks;
+  uint64_t done = 0;
+
+  if (position < fastBlocks) {
+    uint64_t fastCount = fastBlocks - position < count ?
+      fastBlocks - position : count;
+    done = fileIO(0, buffer, fastCount, position, write);
+    if (done < fastCount) {
+      return done;
+    }
+  }
+
+  if (done < count) {
+    done += fileIO(1, buffer + done * deviceBlockSize, count - done,
+      position + done - fastBlocks, write);
+  }
+
+  return done;
+}
+
+//Reads or writes the stripe units of a request that are on the job's
+//volume file. Unit u of the volume is unit u / numVolumeFiles of volume
+//file u % numVolumeFiles.
+void* stripeJob(void* arg) {
+  deviceJob* job = arg;
+  uint64_t end = job->position + job->count;
+  uint64_t rowBlocks = stripeBlocks * numVolumeFiles;
+
+  uint64_t block = job->position;
+  while (block < end) {
+    uint64_t unit = block / stripeBlocks;
+    uint64_t unitEnd = (unit + 1) * stripeBlocks;
+    uint64_t count = (unitEnd < end ? unitEnd : end) - block;
+
+    if (unit % numVolumeFiles == (uint64_t)job->file) {
+      uint64_t fileBlock = block / rowBlocks * stripeBlocks +
+        block % stripeBlocks;
+      uint64_t done = fileIO(job->file,
+        job->buffer + (block - job->position) * deviceBlockSize, count,
+        fileBlock, job->write);
+      job->done += done;
+      if (done < count) {
+        break;
+      }
+    }
+    block += count;
+  }
+
+  return NULL;
+}
+
+//Reads or writes blocks of a striped volume, with a thread for each
+//volume file the request has stripe units on
+uint64_t stripedIO(char* buffer, uint64_t count, uint64_t position,
+  int write) {
+  uint64_t firstUnit = position / stripeBlocks;
+  uint64_t units = (position + count - 1) / stripeBlocks - firstUnit + 1;
+  int numJobs = units < (uint64_t)numVolumeFiles ? units : numVolumeFiles;
+
+  deviceJob jobs[DEVICE_MAX_FILES];
+  pthread_t threads[DEVICE_MAX_FILES];
+  int started[DEVICE_MAX_FILES];
+
+  //The volume file of the first unit is done by the calling thread, and
+  //the others each get a thread of their own
+  for (int i = 0; i < numJobs; i++) {
+    deviceJob* job = &jobs[i];
+    job->file = (firstUnit + i) % numVolumeFiles;
+    job->buffer = buffer;
+    job->count = count;
+    job->position = position;
+    job->write = write;
+    job->done = 0;
+
+    started[i] = i > 0 &&
+      pthread_create(&threads[i], NULL, stripeJob, job) == 0;
+  }
+
+  //A job whose thread could not be started is done here instead
+  for (int i = 0; i < numJobs; i++) {
+    if (!started[i]) {
+      stripeJob(&jobs[i]);
+    }
+  }
+
+  uint64_t done = 0;
+  for (int i = 0; i < numJobs; i++) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+    }
+    done += jobs[i].done;
+  }
+
+  return done;
+}
+
+//Reads or writes all the blocks of a job on the job's volume file
+void* fileJob(void* arg) {
+  deviceJob* job = arg;
+  job->done = fileIO(job->file, job->buffer, job->count, job->position,
+    job->write);
+  return NULL;
+}
+
+//Distance from the last block read from the copy on volume file file to
+//position
+uint64_t mirrorDistance(int file, uint64_t position) {
+  return lastBlock[file] > position ? lastBlock[file] - position :
+    position - lastBlock[file];
+}
+
+//Picks the copy to read count blocks starting at position from, out of
+//those that are up to date: the one with the fewest requests being done,
+//then the one last read nearest position
+int pickMirror(uint64_t position, uint64_t count) {
+  int best = -1;
+  for (int i = 0; i < 2; i++) {
+    if (!mirrorUpToDate(i, position, count)) {
+      continue;
+    }
+    if (best < 0 || pendingIO[i] < pendingIO[best] ||
+      (pendingIO[i] == pendingIO[best] &&
+      mirrorDistance(i, position) < mirrorDistance(best, position))) {
+      best = i;
+    }
+  }
+
+  return best < 0 ? 0 : best;
+}
+
+//Reads or writes blocks of a mirrored volume. Writes go to both copies at
+//the same time, and reads to the one picked by pickMirror, or to both if
+//the read is large.
+uint64_t mirroredIO(char* buffer, uint64_t count, uint64_t position,
+  int write) {
+  deviceJob jobs[2];
+  int numJobs = 2;
+
+  pthread_mutex_lock(&deviceLock);
+  if (write) {
+    //The regions are marked before they change, so if the volume is not
+    //closed they are copied over by a resync
+    mirrorMark(position, count, MIRROR_WRITTEN);
+    for (int i = 0; i < 2; i++) {
+      jobs[i] = (deviceJob){ i, buffer, count, position, 1, 0 };
+    }
+  } else if (count >= MIRROR_SPLIT_BLOCKS &&
+    mirrorUpToDate(0, position, count) && mirrorUpToDate(1, position, count)) {
+    uint64_t half = count / 2;
+    jobs[0] = (deviceJob){ 0, buffer, half, position, 0, 0 };
+    jobs[1] = (deviceJob){ 1, buffer + half * deviceBlockSize, count - half,
+      position + half, 0, 0 };
+  } else {
+    jobs[0] = (deviceJob){ pickMirror(position, count), buffer, count,
+      position, 0, 0 };
+    numJobs = 1;
+  }
+
+  //A read lets go of the lock while it is done, so that reads made
+  //meanwhile see it in pendingIO and pick the other copy
+  for (int i = 0; i < numJobs; i++) {
+    pendingIO[jobs[i].file]++;
+  }
+  if (!write) {
+    pthread_mutex_unlock(&deviceLock);
+  }
+
+  pthread_t thread;
+  int started = numJobs > 1 &&
+    pthread_create(&thread, NULL, fileJob, &jobs[1]) == 0;
+  fileJob(&jobs[0]);
+  if (started) {
+    pthread_join(thread, NULL);
+  } else if (numJobs > 1) {
+    fileJob(&jobs[1]);
+  }
+
+  if (!write) {
+    pthread_mutex_lock(&deviceLock);
+  }
+  for (int i = 0; i < numJobs; i++) {
+    pendingIO[jobs[i].file]--;
+  }
+
+  uint64_t done = 0;
+  for (int i = 0; i < numJobs; i++) {
+    deviceJob* job = &jobs[i];
+    lastBlock[job->file] = job->position + job->done;
+    if (job->done == job->count) {
+      done = write ? count : done + job->count;
+      continue;
+    }
+
+    //A copy that could not be read or written is out of date until a
+    //resync, and the other copy is read instead
+    mirrorMark(job->position, job->count, 1 << job->file);
+    if (!write && mirrorUpToDate(1 - job->file, job->position, job->count)) {
+      job->done = fileIO(1 - job->file, job->buffer, job->count,
+        job->position, 0);
+    }
+    if (!write) {
+      done += job->done;
+      if (job->done < job->count) {
+        break;
+      }
+    }
+  }
+  pthread_mutex_unlock(&deviceLock);
+
+  return done;
+}
+
+//The pieces of a request that go to one volume file
+typedef struct pieceList {
+  deviceJob* pieces;    //Every piece of the request
+  int numPieces;
+  int file;             //The volume file whose pieces this list does
+} pieceList;
+
+//Reads or writes the pieces of a request that go to the list's volume
+//file, one after another
+void* pieceJob(void* arg) {
+  pieceList* list = arg;
+  for (int i = 0; i < list->numPieces; i++) {
+    if (list->pieces[i].file == list->file) {
+      fileJob(&list->pieces[i]);
+    }
+  }
+  return NULL;
+}
+
+//Reads or writes the pieces of a request, with a thread for each volume
+//file after the first that they go to, returning 1 if every piece was
+//done, otherwise 0
+int runPieces(deviceJob* pieces, int numPieces) {
+  pieceList lists[DEVICE_MAX_FILES];
+  pthread_t threads[DEVICE_MAX_FILES];
+  int started[DEVICE_MAX_FILES];
+  int numLists = 0;
+
+  for (int file = 0; file < numVolumeFiles; file++) {
+    for (int i = 0; i < numPieces; i++) {
+      if (pieces[i].file == file) {
+        lists[numLists] = (pieceList){ pieces, numPieces, file };
+        started[numLists] = numLists > 0 &&
+          pthread_create(&threads[numLists], NULL, pieceJob,
+          &lists[numLists]) == 0;
+        numLists++;
+        break;
+      }
+    }
+  }
+
+  //A list whose thread could not be started is done here instead
+  for (int i = 0; i < numLists; i++) {
+    if (!started[i]) {
+      pieceJob(&lists[i]);
+    }
+  }
+  for (int i = 0; i < numLists; i++) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+
+  int allDone = 1;
+  for (int i = 0; i < numPieces; i++) {
+    if (pieces[i].done < pieces[i].count) {
+      allDone = 0;
+    }
+  }
+  return allDone;
+}
+
+//Volume file that holds the parity of stripe row
+int parityFile(uint64_t row) {
+  return numVolumeFiles - 1 - row % numVolumeFiles;
+}
+
+//Volume file that holds data unit unit of stripe row. The data units
+//start on the volume file after the parity and wrap around.
+int dataFile(uint64_t row, int unit) {
+  return (parityFile(row) + 1 + unit) % numVolumeFiles;
+}
+
+//Writes the header of every volume file of a parity volume that is not
+//out of date
+void writeParityHeaders() {
+  char* block = calloc(1, deviceBlockSize);
+  if (!block) {
+    mallocFailed();
+  }
+
+  parityHeader* header = (parityHeader*)block;
+  header->signature = PARITY_SIG;
+  header->volumeId = parityVolumeId;
+  header->failedFile = failedFile;
+  for (int i = 0; i < numVolumeFiles; i++) {
+    if (i != failedFile) {
+      header->file = i;
+      fileIO(i, block, 1, parityRows * stripeBlocks, 1);
+    }
+  }
+
+  free(block);
+  block = NULL;
+}
+
+//Marks a volume file of a parity volume that could not be read or
+//written as out of date, so its blocks are rebuilt from the others until
+//a resync. It returns -1 if another volume file already is, since then
+//the blocks cannot be rebuilt.
+int markFailed(int file) {
+  if (failedFile == file) {
+    return 0;
+  }
+  if (failedFile >= 0) {
+    printf("Error: volume files %d and %d of the volume could not be read "
+      "or written\n", failedFile, file);
+    return -1;
+  }
+
+  failedFile = file;
+  printf("Error: volume file %d could not be read or written, the volume "
+    "is degraded until a resync\n", file);
+  writeParityHeaders();
+  return 0;
+}
+
+//Marks the volume files of the pieces that were not done as out of date,
+//returning -1 if that was more than one volume file
+int markFailedPieces(deviceJob* pieces, int numPieces) {
+  int result = 0;
+  for (int i = 0; i < numPieces; i++) {
+    if (pieces[i].done < pieces[i].count && markFailed(pieces[i].file) < 0) {
+      result = -1;
+    }
+  }
+  return result;
+}
+
+//Stripes the volume with rotated parity across the volume file opened
+//by startPartitionSystem, which holds fileBlocks blocks, and the numFiles
+//volume files in filenames, with unitBlocks blocks in each stripe unit.
+//Volume files that do not exist are created with fileBlocks blocks. It
+//stores the number of blocks in the volume in numBlocks and returns 0 on
+//success and -1 if a file could not be opened or more than one is out of
+//date.
+int deviceAddParity(char** filenames, int numFiles, uint64_t fileBlocks,
+  uint64_t blockSize, uint64_t unitBlocks, uint64_t* numBlocks) {
+  if (numFiles < 2) {
+    printf("Error: a volume with parity needs at least 3 volume files\n");
+    return -1;
+  }
+
+  uint64_t dataBlocks;
+  if (deviceAddStripes(filenames, numFiles, fileBlocks, blockSize,
+    unitBlocks, &dataBlocks) < 0) {
+    return -1;
+  }
+  xorInit();
+
+  //The last stripe unit of each volume file is left for its header
+  parityRows = dataBlocks / numVolumeFiles / unitBlocks - 1;
+  deviceLayout = DEVICE_PARITY;
+  failedFile = -1;
+
+  char* blocks = malloc(numVolumeFiles * blockSize);
+  if (!blocks) {
+    mallocFailed();
+  }
+  parityHeader* headers[DEVICE_MAX_FILES];
+  int valid[DEVICE_MAX_FILES];
+  for (int i = 0; i < numVolumeFiles; i++) {
+    headers[i] = (parityHeader*)(blocks + i * blockSize);
+    valid[i] = fileIO(i, (char*)headers[i], 1, parityRows * unitBlocks,
+      0) == 1 && headers[i]->signature == PARITY_SIG;
+  }
+
+  //The volume is the one most of the headers are from
+  int best = -1;
+  int bestCount = 0;
+  for (int i = 0; i < numVolumeFiles; i++) {
+    int count = 0;
+    for (int j = 0; j < numVolumeFiles && valid[i]; j++) {
+      count += valid[j] && headers[j]->volumeId == headers[i]->volumeId;
+    }
+    if (count > bestCount) {
+      best = i;
+      bestCount = count;
+    }
+  }
+
+  if (best < 0) {
+    //Every volume file is new, or not from a volume with parity, so the
+    //headers are only written once the volume is formatted
+    parityVolumeId = (unsigned int)time(NULL) ^ (unsigned int)getpid();
+  } else {
+    //A volume file is out of date if its header is from another volume
+    //or place in the volume, or the other headers say so
+    parityVolumeId = headers[best]->volumeId;
+    int outOfDate[DEVICE_MAX_FILES] = { 0 };
+    for (int i = 0; i < numVolumeFiles; i++) {
+      if (!valid[i] || headers[i]->volumeId != parityVolumeId ||
+        headers[i]->file != i) {
+        outOfDate[i] = 1;
+      } else if (headers[i]->failedFile >= 0 &&
+        headers[i]->failedFile < numVolumeFiles) {
+        outOfDate[headers[i]->failedFile] = 1;
+      }
+    }
+
+    int numOutOfDate = 0;
+    for (int i = 0; i < numVolumeFiles; i++) {
+      if (outOfDate[i]) {
+        failedFile = i;
+        numOutOfDate++;
+      }
+    }
+    if (numOutOfDate > 1) {
+      printf("Error: %d volume files of the volume are missing or out of "
+        "date\n", numOutOfDate);
+      free(blocks);
+      blocks = NULL;
+      return -1;
+    }
+    if (failedFile >= 0) {
+      printf("Volume file %d is missing or out of date, the volume is "
+        "degraded until a resync\n", failedFile);
+    }
+  }
+
+  free(blocks);
+  blocks = NULL;
+
+  uint64_t rowBlocks = unitBlocks * (numVolumeFiles - 1);
+  pendingData = malloc(rowBlocks * blockSize);
+  pendingValid = malloc(rowBlocks);
+  if (!pendingData || !pendingValid) {
+    mallocFailed();
+  }
+  pendingRow = -1;
+
+  *numBlocks = parityRows * rowBlocks;
+  return 0;
+}
+
+//Reads blocks lo up to hi of each data unit of stripe row into data, with
+//data unit d starting d units into it. The data unit on a volume file
+//that is out of date is rebuilt from the parity and the other data units.
+//It returns 0 on success and -1 if the blocks could not be read.
+int readStripe(uint64_t row, uint64_t lo, uint64_t hi, char* data) {
+  uint64_t unitBytes = stripeBlocks * deviceBlockSize;
+  uint64_t count = hi - lo;
+  uint64_t position = row * stripeBlocks + lo;
+  deviceJob pieces[DEVICE_MAX_FILES];
+  int numPieces = 0;
+  int missing = -1;
+  char* parity = NULL;
+
+  for (int d = 0; d < numVolumeFiles - 1; d++) {
+    int file = dataFile(row, d);
+    if (file == failedFile) {
+      missing = d;
+      continue;
+    }
+    pieces[numPieces++] = (deviceJob){ file,
+      data + d * unitBytes + lo * deviceBlockSize, count, position, 0, 0 };
+  }
+  if (missing >= 0) {
+    parity = malloc(count * deviceBlockSize);
+    if (!parity) {
+      mallocFailed();
+    }
+    pieces[numPieces++] = (deviceJob){ parityFile(row), parity, count,
+      position, 0, 0 };
+  }
+
+  if (!runPieces(pieces, numPieces)) {
+    free(parity);
+    parity = NULL;
+
+    //The blocks are rebuilt if it is the first volume file to fail
+    int hadFailed = failedFile >= 0;
+    if (markFailedPieces(pieces, numPieces) < 0 || hadFailed) {
+      return -1;
+    }
+    return readStripe(row, lo, hi, data);
+  }
+
+  if (missing >= 0) {
+    char* rebuilt = data + missing * unitBytes + lo * deviceBlockSize;
+    memcpy(rebuilt, parity, count * deviceBlockSize);
+    for (int d = 0; d < numVolumeFiles - 1; d++) {
+      if (d != missing) {
+        xorBlocks(rebuilt, data + d * unitBytes + lo * deviceBlockSize,
+          count * deviceBlockSize);
+      }
+    }
+    free(parity);
+    parity = NULL;
+  }
+
+  return 0;
+}
+
+//Writes blocks lo up to hi of the data units of stripe row in the bit
+//mask units from data, laid out as for readStripe, along with the parity
+//of blocks lo up to hi of every data unit. It returns 0 on success and -1
+//if the blocks are lost.
+int writeStripe(uint64_t row, uint64_t lo, uint64_t hi, char* data,
+  int units) {
+  uint64_t unitBytes = stripeBlocks * deviceBlockSize;
+  uint64_t bytes = (hi - lo) * deviceBlockSize;
+  uint64_t position = row * stripeBlocks + lo;
+  deviceJob pieces[DEVICE_MAX_FILES];
+  int numPieces = 0;
+
+  char* parity = malloc(bytes);
+  if (!parity) {
+    mallocFailed();
+  }
+  memcpy(parity, data + lo * deviceBlockSize, bytes);
+  for (int d = 1; d < numVolumeFiles - 1; d++) {
+    xorBlocks(parity, data + d * unitBytes + lo * deviceBlockSize, bytes);
+  }
+
+  //Nothing is written to a volume file that is out of date, since its
+  //blocks are rebuilt from the others
+  for (int d = 0; d < numVolumeFiles - 1; d++) {
+    int file = dataFile(row, d);
+    if ((units & (1 << d)) && file != failedFile) {
+      pieces[numPieces++] = (deviceJob){ file,
+        data + d * unitBytes + lo * deviceBlockSize, hi - lo, position, 1,
+        0 };
+    }
+  }
+  if (parityFile(row) != failedFile) {
+    pieces[numPieces++] = (deviceJob){ parityFile(row), parity, hi - lo,
+      position, 1, 0 };
+  }
+
+  //The parity matches the data written, so the blocks of one volume file
+  //that failed can still be rebuilt
+  int result = 0;
+  if (!runPieces(pieces, numPieces)) {
+    result = markFailedPieces(pieces, numPieces);
+  }
+
+  free(parity);
+  parity = NULL;
+  return result;
+}
+
+//Writes the data held back for part of a stripe. The blocks of the
+//stripe that were not written are read to compute the parity, but only
+//for the blocks of each unit that were written in some unit.
+void flushPendingStripe() {
+  if (pendingRow < 0) {
+    return;
+  }
+
+  uint64_t rowBlocks = stripeBlocks * (numVolumeFiles - 1);
+  uint64_t lo = stripeBlocks;
+  uint64_t hi = 0;
+  int units = 0;
+  for (uint64_t b = 0; b < rowBlocks; b++) {
+    if (pendingValid[b]) {
+      uint64_t within = b % stripeBlocks;
+      lo = within < lo ? within : lo;
+      hi = within + 1 > hi ? within + 1 : hi;
+      units |= 1 << (b / stripeBlocks);
+    }
+  }
+
+  int complete = 1;
+  for (int d = 0; d < numVolumeFiles - 1 && complete; d++) {
+    complete = memchr(pendingValid + d * stripeBlocks + lo, 0, hi - lo) ==
+      NULL;
+  }
+
+  char* data = malloc(rowBlocks * deviceBlockSize);
+  if (!data) {
+    mallocFailed();
+  }
+  if (complete || readStripe(pendingRow, lo, hi, data) == 0) {
+    for (uint64_t b = 0; b < rowBlocks; b++) {
+      if (pendingValid[b]) {
+        memcpy(data + b * deviceBlockSize,
+          pendingData + b * deviceBlockSize, deviceBlockSize);
+      }
+    }
+    writeStripe(pendingRow, lo, hi, data, units);
+  }
+
+  free(data);
+  data = NULL;
+  pendingRow = -1;
+}
+
+//Returns 1 if the blocks from first up to last of stripe row are on a
+//volume file that is out of date, otherwise 0
+int stripeDegraded(uint64_t row, uint64_t first, uint64_t last) {
+  for (uint64_t d = first / stripeBlocks; d <= (last - 1) / stripeBlocks;
+    d++) {
+    if (dataFile(row, d) == failedFile) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+//Reads blocks of a parity volume, with a thread for each volume file the
+//request has blocks on. Blocks on a volume file that is out of date are
+//rebuilt from the rest of their stripe.
+uint64_t parityRead(char* buffer, uint64_t count, uint64_t position) {
+  uint64_t rowBlocks = stripeBlocks * (numVolumeFiles - 1);
+  uint64_t end = position + count;
+  int maxPieces = count / stripeBlocks + 2;
+  deviceJob* pieces = malloc(maxPieces * sizeof(deviceJob));
+  if (!pieces) {
+    mallocFailed();
+  }
+
+  int numPieces = 0;
+  uint64_t block = position;
+  while (block < end) {
+    uint64_t row = block / rowBlocks;
+    uint64_t rowEnd = (row + 1) * rowBlocks < end ? (row + 1) * rowBlocks :
+      end;
+    uint64_t first = block - row * rowBlocks;
+    uint64_t last = rowEnd - row * rowBlocks;
+    char* dest = buffer + (block - position) * deviceBlockSize;
+
+    if (failedFile >= 0 && stripeDegraded(row, first, last)) {
+      //Only the blocks of each unit that were asked for are rebuilt
+      uint64_t lo = 0;
+      uint64_t hi = stripeBlocks;
+      if (first / stripeBlocks == (last - 1) / stripeBlocks) {
+        lo = first % stripeBlocks;
+        hi = (last - 1) % stripeBlocks + 1;
+      }
+      char* data = malloc(rowBlocks * deviceBlockSize);
+      if (!data) {
+        mallocFailed();
+      }
+      int result = readStripe(row, lo, hi, data);
+      memcpy(dest, data + first * deviceBlockSize,
+        (last - first) * deviceBlockSize);
+      free(data);
+      data = NULL;
+      if (result < 0) {
+        free(pieces);
+        pieces = NULL;
+        return block - position;
+      }
+    } else {
+      for (uint64_t b = first; b < last; ) {
+        uint64_t within = b % stripeBlocks;
+        uint64_t n = stripeBlocks - within < last - b ?
+          stripeBlocks - within : last - b;
+        pieces[numPieces++] = (deviceJob){ dataFile(row, b / stripeBlocks),
+          dest + (b - first) * deviceBlockSize, n,
+          row * stripeBlocks + within, 0, 0 };
+        b += n;
+      }
+    }
+    block = rowEnd;
+  }
+
+  int allDone = runPieces(pieces, numPieces);
+  if (!allDone) {
+    //The read is done again with the blocks rebuilt if it is the first
+    //volume file to fail
+    int hadFailed = failedFile >= 0;
+    int result = markFailedPieces(pieces, numPieces);
+    free(pieces);
+    pieces = NULL;
+    return result < 0 || hadFailed ? 0 : parityRead(buffer, count, position);
+  }
+  free(pieces);
+  pieces = NULL;
+
+  //Blocks held back for part of a stripe are newer than those on the disk
+  if (pendingRow >= 0) {
+    for (uint64_t b = 0; b < rowBlocks; b++) {
+      uint64_t logical = pendingRow * rowBlocks + b;
+      if (pendingValid[b] && logical >= position && logical < end) {
+        memcpy(buffer + (logical - position) * deviceBlockSize,
+          pendingData + b * deviceBlockSize, deviceBlockSize);
+      }
+    }
+  }
+
+  return count;
+}
+
+//Writes blocks of a parity volume. Whole stripes are written with their
+//parity without reading anything. Part of a stripe that starts the stripe
+//or carries on from the blocks held back is held back in case the rest of
+//it is written next, as streaming writes smaller than a stripe do, until
+//another stripe is written or deviceFlush is called. Any other part of a
+//stripe is written with its parity right away.
+uint64_t parityWrite(char* buffer, uint64_t count, uint64_t position) {
+  uint64_t rowBlocks = stripeBlocks * (numVolumeFiles - 1);
+  uint64_t end = position + count;
+  int allUnits = (1 << (numVolumeFiles - 1)) - 1;
+
+  uint64_t block = position;
+  while (block < end) {
+    uint64_t row = block / rowBlocks;
+    uint64_t rowEnd = (row + 1) * rowBlocks < end ? (row + 1) * rowBlocks :
+      end;
+    uint64_t first = block - row * rowBlocks;
+    uint64_t last = rowEnd - row * rowBlocks;
+    char* src = buffer + (block - position) * deviceBlockSize;
+
+    if (first == 0 && last == rowBlocks) {
+      if (pendingRow == (int64_t)row) {
+        pendingRow = -1;
+      }
+      if (writeStripe(row, 0, stripeBlocks, src, allUnits) < 0) {
+        return block - position;
+      }
+    } else {
+      if (pendingRow != (int64_t)row) {
+        flushPendingStripe();
+        pendingRow = row;
+        memset(pendingValid, 0, rowBlocks);
+      }
+      int streaming = first == 0 || pendingValid[first - 1];
+      memcpy(pendingData + first * deviceBlockSize, src,
+        (last - first) * deviceBlockSize);
+      memset(pendingValid + first, 1, last - first);
+
+      if (!memchr(pendingValid, 0, rowBlocks)) {
+        pendingRow = -1;
+        if (writeStripe(row, 0, stripeBlocks, pendingData, allUnits) < 0) {
+          return block - position;
+        }
+      } else if (!streaming) {
+        flushPendingStripe();
+      }
+    }
+    block = rowEnd;
+  }
+
+  return count;
+}
+
+//Rebuilds the volume file of a parity volume that is out of date from
+//the others, returning the number of stripes rebuilt or -1 if it could
+//not be rebuilt
+int rebuildParityFile() {
+  flushPendingStripe();
+  if (failedFile < 0) {
+    return 0;
+  }
+
+  uint64_t unitBytes = stripeBlocks * deviceBlockSize;
+  char* data = malloc((numVolumeFiles - 1) * unitBytes);
+  char* parity = malloc(unitBytes);
+  if (!data || !parity) {
+    mallocFailed();
+  }
+
+  int rebuilt = 0;
+  for (uint64_t row = 0; row < parityRows; row++) {
+    if (readStripe(row, 0, stripeBlocks, data) < 0) {
+      rebuilt = -1;
+      break;
+    }
+
+    //The volume file holds either a data unit or the parity of the stripe
+    char* unit;
+    if (parityFile(row) == failedFile) {
+      memcpy(parity, data, unitBytes);
+      for (int d = 1; d < numVolumeFiles - 1; d++) {
+        xorBlocks(parity, data + d * unitBytes, unitBytes);
+      }
+      unit = parity;
+    } else {
+      int d = (failedFile - parityFile(row) - 1 + numVolumeFiles) %
+        numVolumeFiles;
+      unit = data + d * unitBytes;
+    }
+
+    if (fileIO(failedFile, unit, stripeBlocks, row * stripeBlocks, 1) !=
+      stripeBlocks) {
+      printf("Error: volume file %d could not be written\n", failedFile);
+      rebuilt = -1;
+      break;
+    }
+    rebuilt++;
+  }
+
+  if (rebuilt >= 0) {
+    failedFile = -1;
+    writeParityHeaders();
+  }
+
+  free(data);
+  data = NULL;
+  free(parity);
+  parity = NULL;
+
+  return rebuilt;
+}
+
+//Marks every copy of the blocks of the volume as up to date, for a
+//volume that is being formatted, so none of its old blocks are read again
+void deviceFormatted() {
+  pthread_mutex_lock(&deviceLock);
+  if (deviceLayout == DEVICE_MIRRORED) {
+    memset(mirrorRegion(0), 0, mirrorRegions);
+    writeMirrorTable();
+  } else if (deviceLayout == DEVICE_PARITY) {
+    failedFile = -1;
+    writeParityHeaders();
+  }
+  pthread_mutex_unlock(&deviceLock);
+}
+
+//Copies the out of date regions of a mirrored volume from the volume
+//file with an up to date copy, or rebuilds the stripes of the volume file
+//of a parity volume that is out of date. It returns the number of regions
+//or stripes copied, or -1 if the volume has no second copy.
+int deviceResync() {
+  if (deviceLayout == DEVICE_PARITY) {
+    pthread_mutex_lock(&deviceLock);
+    int rebuilt = rebuildParityFile();
+    pthread_mutex_unlock(&deviceLock);
+    return rebuilt;
+  }
+  if (deviceLayout != DEVICE_MIRRORED) {
+    printf("Error: the volume is not mirrored and has no parity\n");
+    return -1;
+  }
+
+  char* buffer = malloc(MIRROR_REGION_BLOCKS * deviceBlockSize);
+  if (!buffer) {
+    mallocFailed();
+  }
+
+  pthread_mutex_lock(&deviceLock);
+  int copied = 0;
+  for (uint64_t r = 0; r < mirrorRegions; r++) {
+    unsigned char* state = mirrorRegion(r);
+    int outOfDate = *state & 3;
+    if (!outOfDate) {
+      continue;
+    }
+
+    //A region out of date on both copies is made the same again with the
+    //copy on the volume file opened by startPartitionSystem
+    int from = outOfDate == 1 ? 1 : 0;
+    uint64_t position = r * MIRROR_REGION_BLOCKS;
+    uint64_t count = mirrorTableStart - position < MIRROR_REGION_BLOCKS ?
+      mirrorTableStart - position : MIRROR_REGION_BLOCKS;
+    if (fileIO(from, buffer, count, position, 0) == count &&
+      fileIO(1 - from, buffer, count, position, 1) == count) {
+      *state &= ~3;
+      copied++;
+    }
+  }
+  writeMirrorTable();
+  pthread_mutex_unlock(&deviceLock);
+
+  free(buffer);
+  buffer = NULL;
+
+  return copied;
+}
+
+//Number of blocks on the fast volume file (0 if the volume is not tiered)
+uint64_t deviceFastBlocks() {
+  return deviceLayout == DEVICE_TIERED ? volumeFiles[0].numBlocks : 0;
+}
+
+//Number of volume files the volume is striped across (0 if it is not)
+int deviceStripeFiles() {
+  return deviceLayout == DEVICE_STRIPED || deviceLayout == DEVICE_PARITY ?
+    numVolumeFiles : 0;
+}
+
+//Number of blocks in each stripe unit (0 if the volume is not striped)
+int deviceStripeBlocks() {
+  return deviceLayout == DEVICE_STRIPED || deviceLayout == DEVICE_PARITY ?
+    stripeBlocks : 0;
+}
+
+//1 if the stripes of the volume have parity, otherwise 0
+int deviceParity() {
+  return deviceLayout == DEVICE_PARITY;
+}
+
+//1 if the volume is mirrored, otherwise 0
+int deviceMirrored() {
+  return deviceLayout == DEVICE_MIRRORED;
+}
+
+//Writes the data held back for part of a stripe of a parity volume
+void deviceFlush() {
+  pthread_mutex_lock(&deviceLock);
+  if (deviceLayout == DEVICE_PARITY) {
+    flushPendingStripe();
+  }
+  pthread_mutex_unlock(&deviceLock);
+}
+
+//Closes the volume files added to the one opened by startPartitionSystem
+void deviceClose() {
+  pthread_mutex_lock(&deviceLock);
+
+  //Every write to a mirrored volume is done, so the regions written are
+  //the same on both copies
+  if (mirrorTable) {
+    int written = 0;
+    for (uint64_t r = 0; r < mirrorRegions; r++) {
+      written |= *mirrorRegion(r) & MIRROR_WRITTEN;
+      *mirrorRegion(r) &= ~MIRROR_WRITTEN;
+    }
+    if (written) {
+      writeMirrorTable();
+    }
+    free(mirrorTable);
+    mirrorTable = NULL;
+  }
+
+  //Data held back for part of a stripe is written with its parity
+  if (pendingData) {
+    if (deviceLayout == DEVICE_PARITY) {
+      flushPendingStripe();
+    }
+    free(pendingData);
+    pendingData = NULL;
+    free(pendingValid);
+    pendingValid = NULL;
+  }
+  failedFile = -1;
+
+  for (int i = 1; i < numVolumeFiles; i++) {
+    close(volumeFiles[i].fd);
+    volumeFiles[i].fd = -1;
+  }
+  numVolumeFiles = 1;
+  deviceLayout = DEVICE_SINGLE;
+  pthread_mutex_unlock(&deviceLock);
+}
+
+//Reads or writes lbaCount blocks starting at block lbaPosition of the
+//volume, sending each block to the volume file that holds it
+uint64_t deviceIO(char* buffer, uint64_t lbaCount, uint64_t lbaPosition,
+  int write) {
+  switch (deviceLayout) {
+  case DEVICE_STRIPED:
+    return stripedIO(buffer, lbaCount, lbaPosition, write);
+  case DEVICE_MIRRORED:
+    return mirroredIO(buffer, lbaCount, lbaPosition, write);
+  case DEVICE_SINGLE:
+    return fileIO(0, buffer, lbaCount, lbaPosition, write);
+  }
+
+  uint64_t done;
+  pthread_mutex_lock(&deviceLock);
+  switch (deviceLayout) {
+  case DEVICE_TIERED:
+    tierTouch(lbaPosition, lbaCount);
+    done = tieredIO(buffer, lbaCount, lbaPosition, write);
+    break;
+  default:
+    done = write ? parityWrite(buffer, lbaCount, lbaPosition) :
+      parityRead(buffer, lbaCount, lbaPosition);
+    break;
+  }
+  pthread_mutex_unlock(&deviceLock);
+
+  return done;
+}
+
+//Reads lbaCount blocks starting at block lbaPosition of the volume
+uint64_t deviceRead(void* buffer, uint64_t lbaCount, uint64_t lbaPosition) {
+  return deviceIO(buffer, lbaCount, lbaPosition, 0);
+}
+
+//Writes lbaCount blocks starting at block lbaPosition of the volume
+uint64_t deviceWrite(void* buffer, uint64_t lbaCount, uint64_t lbaPosition) {
+  return deviceIO(buffer, lbaCount, lbaPosition, 1);
+}
@@ -0,0 +1,122 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: device.h
+*
+* Description: This file holds the prototypes of the functions the
+* file system reads and writes the volume's blocks with. A volume is
+* usually the one volume file opened by startPartitionSystem, but it
+* can also be made up of more than one volume file. These functions
+* send each block to the volume file that holds it.
+*
+**************************************************************/
+#ifndef DEVICE_H
+#define DEVICE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "fsLow.h"
+
+//How the blocks of the volume are spread over its volume files
+#define DEVICE_SINGLE 0   //All blocks are in the one volume file
+#define DEVICE_TIERED 1   //The blocks of the fast volume file come first,
+                          //then those of the slow volume file
+#define DEVICE_STRIPED 2  //The blocks are split into stripe units that go
+                          //to each volume file in turn
+#define DEVICE_MIRRORED 3 //Every block is in both volume files
+#define DEVICE_PARITY 4   //Striped, with a unit of parity in each stripe
+
+#define DEVICE_MAX_FILES 16   //Most volume files a volume can be made of
+
+//A mirrored volume keeps a table in the last blocks of both volume files
+//of which regions of each copy are out of date. Bit f of a region's state
+//is set when the copy on volume file f is out of date.
+#define MIRROR_SIG 0x4D495252      //Signature of a written mirror table
+#define MIRROR_REGION_BLOCKS 128   //Blocks in each region of the table
+#define MIRROR_WRITTEN 4           //State bit of regions written since the
+                                   //volume was opened, which may differ
+                                   //if the volume was not closed
+#define MIRROR_SPLIT_BLOCKS 16     //Reads of at least this many blocks are
+                                   //split between both copies
+
+#define PARITY_SIG 0x50415249      //Signature of the header of each
+                                   //volume file of a parity volume
+
+//Adds a slow volume file to the fast one opened by startPartitionSystem,
+//which holds numFastBlocks blocks. The slow file is created with
+//numBlocks blocks if it does not exist, otherwise numBlocks is set to its
+//size. It returns 0 on success and -1 if the file could not be opened.
+int deviceAddSlowTier(char* filename, uint64_t* numBlocks,
+  uint64_t numFastBlocks, uint64_t blockSize);
+
+//Stripes the volume across the volume file opened by startPartitionSystem,
+//which holds fileBlocks blocks, and the numFiles volume files in
+//filenames, with unitBlocks blocks in each stripe unit. Volume files that
+//do not exist are created with fileBlocks blocks. It stores the number of
+//blocks in the volume in numBlocks and returns 0 on success and -1 if a
+//file could not be opened.
+int deviceAddStripes(char** filenames, int numFiles, uint64_t fileBlocks,
+  uint64_t blockSize, uint64_t unitBlocks, uint64_t* numBlocks);
+
+//Mirrors the volume file opened by startPartitionSystem, which holds
+//fileBlocks blocks, onto the volume file filename, which is created with
+//fileBlocks blocks if it does not exist. It stores the number of blocks
+//in the volume in numBlocks and returns 0 on success and -1 if the mirror
+//could not be opened.
+int deviceAddMirror(char* filename, uint64_t fileBlocks, uint64_t blockSize,
+  uint64_t* numBlocks);
+
+//Stripes the volume with rotated parity across the volume file opened
+//by startPartitionSystem, which holds fileBlocks blocks, and the numFiles
+//volume files in filenames, with unitBlocks blocks in each stripe unit.
+//Volume files that do not exist are created with fileBlocks blocks. It
+//stores the number of blocks in the volume in numBlocks and returns 0 on
+//success and -1 if a file could not be opened or more than one is out of
+//date.
+int deviceAddParity(char** filenames, int numFiles, uint64_t fileBlocks,
+  uint64_t blockSize, uint64_t unitBlocks, uint64_t* numBlocks);
+
+//Marks every copy of the blocks of the volume as up to date, for a
+//volume that is being formatted, so none of its old blocks are read again
+void deviceFormatted();
+
+//Copies the out of date regions of a mirrored volume from the volume
+//file with an up to date copy, or rebuilds the stripes of the volume file
+//of a parity volume that is out of date. It returns the number of regions
+//or stripes copied, or -1 if the volume has no second copy.
+int deviceResync();
+
+//Number of blocks on the fast volume file (0 if the volume is not tiered)
+uint64_t deviceFastBlocks();
+
+//Number of volume files the volume is striped across (0 if it is not)
+int deviceStripeFiles();
+
+//Number of blocks in each stripe unit (0 if the volume is not striped)
+int deviceStripeBlocks();
+
+//1 if the stripes of the volume have parity, otherwise 0
+int deviceParity();
+
+//1 if the volume is mirrored, otherwise 0
+int deviceMirrored();
+
+//Writes any data the volume is holding back to its volume files, so that
+//everything written so far is on the disk
+void deviceFlush();
+
+//Closes the volume files added to the one opened by startPartitionSystem
+void deviceClose();
+
+//Reads lbaCount blocks starting at block lbaPosition of the volume
+uint64_t deviceRead(void* buffer, uint64_t lbaCount, uint64_t lbaPosition);
+
+//Writes lbaCount blocks starting at block lbaPosition of the volume
+uint64_t deviceWrite(void* buffer, uint64_t lbaCount, uint64_t lbaPosition);
+
+#endif
@@ -24,7 +24,7 @@ void mallocFailed() {
 
 //Initialize a new directory entry
 dirEntry* dirEntryInit(char filename[20], int isDir, int location,
-  unsigned int fileSize, time_t dateModified, time_t dateCreated) {
+  off_t fileSize, time_t dateModified, time_t dateCreated) {
 
   dirEntry* entry = malloc(sizeof(dirEntry));
   if (!entry) {
@@ -37,10 +37,18 @@ dirEntry* dirEntryInit(char filename[20], int isDir, int location,
   entry->fileSize = fileSize;
   entry->dateModified = dateModified;
   entry->dateCreated = dateCreated;
+  entry->tailMap = 0;
+  entry->compressed = 0;
+  entry->inlineLen = 0;
 
   return entry;
 }
 
+//Number of bytes a directory entry takes up when it is written to disk
+int dirRecordSize(dirEntry* entry) {
+  return DIR_RECORD_SIZE + entry->inlineLen;
+}
+
 //Get the hash value for a given key (filenames are used as keys)
 int hash(const char filename[20]) {
   int value = 1;
@@ -86,13 +94,15 @@ node* entryInit(char key[20], dirEntry* value) {
 }
 
 //Initialize a new hashTable
-hashTable* hashTableInit(char* dirName, int maxNumEntries, int location) {
+hashTable* hashTableInit(char* dirName, int maxNumEntries, int maxDataSize,
+  int location) {
   hashTable* table = malloc(sizeof(node) * SIZE);
   if (!table) {
     mallocFailed();
   }
 
   table->maxNumEntries = maxNumEntries;
+  table->maxDataSize = maxDataSize;
   table->location = location;
   strcpy(table->dirName, dirName);
 
@@ -105,21 +115,48 @@ hashTable* hashTableInit(char* dirName, int maxNumEntries, int location) {
   }
 
   table->numEntries = 0; //The hash table will start out as empty
+  table->dataSize = 0;
 
   return table;
 }
 
-//Update an existing entry or add a new one
-void setEntry(char key[20], dirEntry* value, hashTable* table) {
+//Check if the table has room to add or update an entry (1 = yes, 0 = no)
+int hasRoomFor(char key[20], dirEntry* value, hashTable* table) {
+  dirEntry* existing = getEntry(key, table);
+
+  //If we have already reached the maximum number of entries, there is
+  //no room for another one
+  if (!existing && table->numEntries == table->maxNumEntries) {
+    return 0;
+  }
+
+  //The entry's record also has to fit in the space left on the disk
+  int newDataSize = table->dataSize + dirRecordSize(value);
+  if (existing) {
+    newDataSize -= dirRecordSize(existing);
+  }
+
+  return newDataSize <= table->maxDataSize;
+}
+
+//Update an existing entry or add a new one (1 = success, 0 = directory full)
+int setEntry(char key[20], dirEntry* value, hashTable* table) {
   //Get the entry based on the hash value calculated from the key
   int hashVal = hash(key);
   node* entry = table->entries[hashVal];
 
   //If we have already reached the maximum capacity of the directory,
   //Don't attempt to create another directory entry
-  if (table->numEntries == table->maxNumEntries) {
+  if (!hasRoomFor(key, value, table)) {
     printf("Error: cannot create file/directory: directory is full\n");
-    return;
+    return 0;
+  }
+
+  //Update the space the directory's entries take up on the disk
+  dirEntry* existing = getEntry(key, table);
+  table->dataSize += dirRecordSize(value);
+  if (existing) {
+    table->dataSize -= dirRecordSize(existing);
   }
 
   //If there is no collision then add a new initialized entry
@@ -131,7 +168,7 @@ void setEntry(char key[20], dirEntry* value, hashTable* table) {
 
     table->entries[hashVal] = entryInit(key, value);
     table->numEntries++;
-    return;
+    return 1;
   }
 
   node* prevEntry;
@@ -142,9 +179,10 @@ void setEntry(char key[20], dirEntry* value, hashTable* table) {
     //If the current entry has the same key that we are attempting 
     //to add then update the existing entry
     if (strcmp(entry->key, key) == 0) {
-      entry->value = realloc(entry->value, sizeof(dirEntry));
-      memcpy(entry->value, value, sizeof(dirEntry));
-      return;
+      if (entry->value != value) {
+        memcpy(entry->value, value, sizeof(dirEntry));
+      }
+      return 1;
     }
 
     //Move on to check the next entry at the current table location
@@ -156,6 +194,7 @@ void setEntry(char key[20], dirEntry* value, hashTable* table) {
   //the end of the list at that location
   prevEntry->next = entryInit(key, value);
   table->numEntries++;
+  return 1;
 
 }
 
@@ -210,6 +249,7 @@ int rmEntry(char key[20], hashTable* table) {
       }
 
       table->numEntries--;
+      table->dataSize -= dirRecordSize(entry->value);
       free(entry->value);
       free(entry);
       return 1;
@@ -225,7 +265,8 @@ int rmEntry(char key[20], hashTable* table) {
 
 //Given an index, find the index of the next entry in the table
 int getNextIdx(int currIdx, hashTable* table) {
-  int max = table->maxNumEntries;
+  //SIZE is never a valid index so it marks the start and end of the table
+  int max = SIZE;
 
   //These static variables are used to track our position in the linked list 
   //if we have more than 1 value hashed to a location
@@ -304,35 +345,22 @@ void printTable(hashTable* table) {
 
 //Free the memory allocated to the hashTable
 void clean(hashTable* table) {
-  //Store a reference to next so we can access it 
-  //after freeing the current entry
-  node* next = malloc(sizeof(node));
-
-  //Iterate through the hash table and free every entry and entry->value
+  //Iterate through the hash table and free every entry and entry->value,
+  //including the other entries hashed to the same location
   for (int i = 0; i < SIZE; i++) {
     node* entry = table->entries[i];
-    if (entry->next) {
-      memcpy(next, entry->next, sizeof(node));
-    }
 
-    free(entry->value);
-    free(entry);
-
-    while (next != NULL) {
-      entry = next;
-      if (entry->next) {
-        memcpy(next, entry->next, sizeof(node));
-      } else {
-        break;
-      }
+    while (entry != NULL) {
+      //Store a reference to next so we can access it 
+      //after freeing the current entry
+      node* next = entry->next;
       free(entry->value);
       free(entry);
+      entry = next;
     }
   }
 
-  //Free our next pointer and the table
-  free(next);
-  next = NULL;
+  //Free the table
   free(table);
   table = NULL;
 }
\ No newline at end of file
@@ -23,20 +23,33 @@
 #include <sys/types.h>
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
 #include "fsLow.h"
 
 #define ENTRIES_PER_BLOCK 16
 #define SIZE 53  
+#define DIR_NAME_SIZE 20
+#define MAX_INLINE_SIZE 256   //Largest file whose data is kept in its entry
 
 typedef struct dirEntry {
   int isDir;              //1 if entry is a directory, 0 if it is a file
   int location;           //The block number where the start of the file is stored
   char filename[20];      //The name of the file (provided by creator)
-  unsigned int fileSize;  //Length of file in bytes
+  off_t fileSize;         //Length of file in bytes (64 bits)
   time_t dateModified;    //Date file was last modified
   time_t dateCreated;	    //Date file was created
+  int tailMap;            //The block number of the last block of the file's
+                          //block map, so appending does not walk the map
+  int compressed;         //1 if the file's data is stored compressed
+  unsigned short inlineLen;   //Number of bytes of file data kept in inlineData
+  char inlineData[MAX_INLINE_SIZE]; //Data of a small file that has no blocks
 } dirEntry;
 
+//On disk each directory entry is a variable length record made up of the
+//record's length, the fields of the entry up to inlineData, and then only
+//the inlineLen bytes of inlineData that are in use
+#define DIR_RECORD_SIZE (sizeof(unsigned short) + offsetof(dirEntry, inlineData))
+
 //Node objects are used to populate the hash table
 typedef struct node {
   char key[20];       //filename 
@@ -49,6 +62,8 @@ typedef struct hashTable {
   node* entries[SIZE];
   int numEntries;
   int maxNumEntries;
+  int dataSize;       //Bytes the entries take up when written to disk
+  int maxDataSize;    //Bytes the directory has room for on disk
   int location;
   char dirName[20];
 } hashTable;
@@ -65,7 +80,7 @@ void mallocFailed();
 
 //Initialize a new directory entry
 dirEntry* dirEntryInit(char filename[20], int isDir, int location,
-  unsigned int fileSize, time_t dateModified, time_t dateCreated);
+  off_t fileSize, time_t dateModified, time_t dateCreated);
 
 //Get the hash value for a given key (filenames are used as keys)
 int hash(const char filename[20]);
@@ -73,11 +88,18 @@ int hash(const char filename[20]);
 //Initialize an entry for the hash table
 node* entryInit(char key[20], dirEntry* value);
 
+//Number of bytes a directory entry takes up when it is written to disk
+int dirRecordSize(dirEntry* entry);
+
 //Initialize a new hashTable
-hashTable* hashTableInit(char* dirName, int maxNumEntries, int location);
+hashTable* hashTableInit(char* dirName, int maxNumEntries, int maxDataSize,
+  int location);
+
+//Check if the table has room to add or update an entry (1 = yes, 0 = no)
+int hasRoomFor(char key[20], dirEntry* value, hashTable* table);
 
-//Update an existing entry or add a new one
-void setEntry(char key[20], dirEntry* value, hashTable* table);
+//Update an existing entry or add a new one (1 = success, 0 = directory full)
+int setEntry(char key[20], dirEntry* value, hashTable* table);
 
 //Retrieve an entry from a provided hashTable
 dirEntry* getEntry(char key[20], hashTable* table);
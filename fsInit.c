@@ -21,6 +21,26 @@
 #include "fsLow.h"
 #include <time.h>
 #include "b_io.h"
+#include "refTable.h"
+#include "checksum.h"
+#include "segment.h"
+#include "tier.h"
+
+//Sets the size of the clusters space is allocated in and the number of
+//ints the free space bit vector needs to have a bit for every cluster
+void setClusterSize(int numClusterBlocks, uint64_t numberOfBlocks) {
+  clusterBlocks = numClusterBlocks;
+  clusterSize = numClusterBlocks * blockSize;
+
+  // We will be dealing with free space using 32 bits at a time
+  // represented by 1 int that's why we need to determine how
+  // many such ints we need, so with 1 block clusters we need:
+  // 19531 / 32 = 610 + 1 = 611 ints, because 611 * 32 = 19552 bits
+  // which are enough to represent 19531 clusters. The reason why we
+  // add 1 to the 610 is because 610 * 32 = 19520 bits which are not
+  // enough to represent 19531 clusters
+  numOfInts = ((numberOfBlocks / numClusterBlocks) / 32) + 1;
+}
 
 //Initialize the file system
 int initFileSystem(uint64_t numberOfBlocks, uint64_t definedBlockSize) {
@@ -29,48 +49,144 @@ int initFileSystem(uint64_t numberOfBlocks, uint64_t definedBlockSize) {
     numberOfBlocks, definedBlockSize);
 
   blockSize = definedBlockSize;
-  // We will be dealing with free space using 32 bits at a time
-  // represented by 1 int that's why we need to determine how
-  // many such ints we need, so we need: 19531 / 32 = 610 + 1 = 611
-  // ints, because 611 * 32 = 19552 bits which are enough to
-  // represent 19531 blocks. The reason why we add 1 to the 610
-  // is because 610 * 32 = 19520 bits which are not enough to
-  // represent 19531 blocks
-  numOfInts = (numberOfBlocks / 32) + 1;
-
 
   // This will help us determine the int block in which we found a bit of 
   // value 1 representing free block
   intBlock = 0;
 
-  struct volumeCtrlBlock* vcbPtr = malloc(definedBlockSize);
+  struct volumeCtrlBlock* vcbPtr = calloc(definedBlockSize, 1);
   if (!vcbPtr) {
     mallocFailed();
   }
 
   // Reads data into VCB to check signature
-  LBAread(vcbPtr, 1, 0);
+  deviceRead(vcbPtr, 1, 0);
 
-  if (vcbPtr->signature == SIG) {
-    //Volume was already formatted
-    int sizeOfEntry = sizeof(dirEntry);	//48 bytes
-    int dirSizeInBytes = (DIR_SIZE * definedBlockSize);	//2560 bytes
-    int maxNumEntries = (dirSizeInBytes / sizeOfEntry) - 1; //52 entries
+  if (vcbPtr->signature == OLD_SIG) {
+    //Volume was formatted with block links stored inside the data blocks,
+    //which this version of the file system can no longer read
+    printf("Error: volume uses the old in-band block layout, "
+      "remove the volume file to reformat it\n");
+    free(vcbPtr);
+    vcbPtr = NULL;
+    return -1;
+  } else if (vcbPtr->signature == SIG) {
+    //A tiered volume can only be used with the slow volume file it was
+    //formatted with
+    if (vcbPtr->fastBlocks != (long)deviceFastBlocks()) {
+      printf("Error: volume was formatted with %ld blocks on its fast tier "
+        "but has %ld\n", vcbPtr->fastBlocks, (long)deviceFastBlocks());
+      free(vcbPtr);
+      vcbPtr = NULL;
+      return -1;
+    }
+
+    //A striped volume's blocks are only where they were written if it has
+    //the same volume files and stripe unit it was formatted with
+    if (vcbPtr->stripeFiles != deviceStripeFiles() ||
+      vcbPtr->stripeBlocks != deviceStripeBlocks()) {
+      printf("Error: volume was formatted striped across %d volume files "
+        "with %d blocks in each stripe unit but has %d with %d\n",
+        vcbPtr->stripeFiles, vcbPtr->stripeBlocks, deviceStripeFiles(),
+        deviceStripeBlocks());
+      free(vcbPtr);
+      vcbPtr = NULL;
+      return -1;
+    }
+
+    //The stripes of a volume with parity hold a unit less of data
+    if (vcbPtr->parity != deviceParity()) {
+      printf("Error: volume was formatted %s but is opened %s\n",
+        vcbPtr->parity ? "with parity" : "without parity",
+        deviceParity() ? "with parity" : "without parity");
+      free(vcbPtr);
+      vcbPtr = NULL;
+      return -1;
+    }
+
+    //A mirrored volume keeps its mirror table in its last blocks
+    if (vcbPtr->mirrored != deviceMirrored()) {
+      printf("Error: volume was formatted %s but is opened %s\n",
+        vcbPtr->mirrored ? "mirrored" : "without a mirror",
+        deviceMirrored() ? "mirrored" : "without a mirror");
+      free(vcbPtr);
+      vcbPtr = NULL;
+      return -1;
+    }
+
+    //Volume was already formatted, so we use the cluster size it was
+    //formatted with (volumes from before clusters used single blocks)
+    setClusterSize(vcbPtr->clusterBlocks ? vcbPtr->clusterBlocks : 1,
+      numberOfBlocks);
+    freeSpaceBlocks = vcbPtr->freeSpaceBlocks ? vcbPtr->freeSpaceBlocks :
+      NUM_FREE_SPACE_BLOCKS;
+
+    //The size of a striped volume comes from the size of its volume
+    //files, which may have grown past what its bit vector has bits for
+    if (numOfInts * sizeof(int) > (size_t)freeSpaceBlocks * blockSize) {
+      printf("Error: volume has %ld clusters but its free space bit vector "
+        "only holds %ld\n", (long)(numberOfBlocks / clusterBlocks),
+        (long)freeSpaceBlocks * blockSize * 8);
+      free(vcbPtr);
+      vcbPtr = NULL;
+      return -1;
+    }
+    compressFiles = vcbPtr->compression;
+    logStructured = vcbPtr->logStructured;
+    refTableInit(vcbPtr->refTable, vcbPtr->dedupTable,
+      numberOfBlocks / clusterBlocks);
+    checksumTableInit(vcbPtr->checksumTable, numberOfBlocks / clusterBlocks);
+    tierInit(numberOfBlocks / clusterBlocks);
 
     // Initialize our root directory to be a new hash table of directory entries
-    hashTable* rootDir = hashTableInit("/", maxNumEntries, vcbPtr->rootDir);
-    workingDir = readTableData(rootDir->location);
+    workingDir = readTableData(vcbPtr->rootDir);
   } else {
     //Volume was not properly formatted
     vcbPtr->signature = SIG;
     vcbPtr->blockSize = definedBlockSize;
     vcbPtr->blockCount = numberOfBlocks;
     vcbPtr->freeBlockNum = FREE_SPACE_START_BLOCK;
+    vcbPtr->layout = LAYOUT_BLOCK_MAP;
+
+    // The cluster size must be a power of two number of blocks no
+    // larger than MAX_CLUSTER_SIZE, otherwise we use single blocks
+    int newClusterBlocks = 1;
+    if (formatClusterSize > 0) {
+      int size = formatClusterSize;
+      if (size % definedBlockSize != 0 || size > MAX_CLUSTER_SIZE ||
+        ((size / definedBlockSize) & (size / definedBlockSize - 1)) != 0) {
+        printf("Error: cluster size %d is not a power of two multiple of "
+          "the block size up to %d bytes, using %ld\n", size,
+          MAX_CLUSTER_SIZE, definedBlockSize);
+      } else {
+        newClusterBlocks = size / definedBlockSize;
+      }
+    }
+    vcbPtr->clusterBlocks = newClusterBlocks;
+    vcbPtr->compression = compressFiles;
+    vcbPtr->logStructured = logStructured;
+    vcbPtr->fastBlocks = deviceFastBlocks();
+    vcbPtr->stripeFiles = deviceStripeFiles();
+    vcbPtr->stripeBlocks = deviceStripeBlocks();
+    vcbPtr->mirrored = deviceMirrored();
+    vcbPtr->parity = deviceParity();
+    deviceFormatted();
+    setClusterSize(newClusterBlocks, numberOfBlocks);
+
+    // The bit vector takes as many blocks as the bits of every cluster
+    // need, which is never fewer than NUM_FREE_SPACE_BLOCKS so that the
+    // layout of small volumes stays the same
+    freeSpaceBlocks = (numOfInts * sizeof(int) + definedBlockSize - 1) /
+      definedBlockSize;
+    if (freeSpaceBlocks < NUM_FREE_SPACE_BLOCKS) {
+      freeSpaceBlocks = NUM_FREE_SPACE_BLOCKS;
+    }
+    vcbPtr->freeSpaceBlocks = freeSpaceBlocks;
 
     // Since we can only read and write data to and from LBA in
     // blocks we need to malloc memory for our bitVector in
     // block sizes as well
-    int* bitVector = malloc(NUM_FREE_SPACE_BLOCKS * definedBlockSize);
+    int* bitVector = calloc(freeSpaceBlocks, definedBlockSize);
     if (!bitVector) {
       mallocFailed();
     }
@@ -78,35 +194,24 @@ int initFileSystem(uint64_t numberOfBlocks, uint64_t definedBlockSize) {
     // 0 = occupied
     // 1 = free
 
-    // Set first 6 bits to 0 and the rest of 25 bits of 1st integer to 1, 
-    // because block 0 of LBA is the VCB, and 1 to NUM_FREE_SPACE_BLOCKS blocks 
-    // will be taken by the bitVector itself
-    int totalBits = 0;
-    for (int i = 31; i >= 0; i--) {
-      totalBits++;
-      if (i >= 26) {
-        // Set bit to 0
-        bitVector[0] = bitVector[0] & ~(1 << i);
-      } else {
-        // Set bit to 1
-        bitVector[0] = bitVector[0] | (1 << i);
-      }
-    }
-
-    // Set all the bits starting from bit 33 to 1
-    for (int i = 1; i < numOfInts; i++) {
-      for (int j = 31; j >= 0; j--) {
-
-        // Set bit to 1
-        bitVector[i] = bitVector[i] | (1 << j);
-      }
+    // Set the bit of every cluster on the volume to 1, leaving the bits
+    // past the last cluster as 0 so they are never handed out
+    int numClusters = numberOfBlocks / clusterBlocks;
+    for (int cluster = 0; cluster < numClusters; cluster++) {
+      bitVector[cluster / 32] = bitVector[cluster / 32] |
+        (1 << (31 - cluster % 32));
     }
 
     // Saves starting block of the free space and root directory in the VCB
-    int numBlocksWritten = LBAwrite(bitVector, NUM_FREE_SPACE_BLOCKS, FREE_SPACE_START_BLOCK);
+    int numBlocksWritten = deviceWrite(bitVector, freeSpaceBlocks, FREE_SPACE_START_BLOCK);
+
+    // Block 0 of LBA is the VCB, and 1 to freeSpaceBlocks blocks
+    // will be taken by the bitVector itself, so the clusters holding
+    // them are in use
+    setBlocksAsAllocated(0, FREE_SPACE_START_BLOCK + numBlocksWritten);
 
     vcbPtr->freeBlockNum = FREE_SPACE_START_BLOCK;
-    int freeBlock = getFreeBlockNum(DIR_SIZE);
+    int freeBlock = getMetadataBlockNum(DIR_SIZE);
 
     // Check if the freeBlock returned is valid or not
     if (freeBlock < 0) {
@@ -117,29 +222,52 @@ int initFileSystem(uint64_t numberOfBlocks, uint64_t definedBlockSize) {
       return -1;
     }
     vcbPtr->rootDir = freeBlock;
+    setBlocksAsAllocated(vcbPtr->rootDir, DIR_SIZE);
+
+    // Create the tables that let clusters be shared by more than one file
+    if (refTableCreate(numClusters, formatDedup, &vcbPtr->refTable,
+      &vcbPtr->dedupTable) < 0) {
+      free(bitVector);
+      bitVector = NULL;
+      free(vcbPtr);
+      vcbPtr = NULL;
+      return -1;
+    }
+    refTableInit(vcbPtr->refTable, vcbPtr->dedupTable, numClusters);
+
+    // Create the table that holds the checksum of every data cluster
+    vcbPtr->checksumTable = checksumTableCreate(numClusters);
+    if (vcbPtr->checksumTable < 0) {
+      free(bitVector);
+      bitVector = NULL;
+      free(vcbPtr);
+      vcbPtr = NULL;
+      return -1;
+    }
+    checksumTableInit(vcbPtr->checksumTable, numClusters);
+    tierInit(numClusters);
 
-    int sizeOfEntry = sizeof(dirEntry);	//48 bytes
     int dirSizeInBytes = (DIR_SIZE * definedBlockSize);	//2560 bytes
-    int maxNumEntries = (dirSizeInBytes / sizeOfEntry) - 1; //52 entries
 
     // Initialize our root directory to be a new hash table of directory entries
-    hashTable* rootDir = hashTableInit("/", maxNumEntries, vcbPtr->rootDir);
+    hashTable* rootDir = hashTableInit("/", MAX_DIR_ENTRIES, DIR_DATA_SIZE,
+      vcbPtr->rootDir);
 
     // Initializing the "." current directory and the ".." parent Directory 
-    dirEntry* curDir = dirEntryInit(".", 1, FREE_SPACE_START_BLOCK + numBlocksWritten,
+    dirEntry* curDir = dirEntryInit(".", 1, vcbPtr->rootDir,
       dirSizeInBytes, time(0), time(0));
     setEntry(curDir->filename, curDir, rootDir);
 
-    dirEntry* parentDir = dirEntryInit("..", 1, FREE_SPACE_START_BLOCK +
-      numBlocksWritten, dirSizeInBytes, time(0), time(0));
+    dirEntry* parentDir = dirEntryInit("..", 1, vcbPtr->rootDir,
+      dirSizeInBytes, time(0), time(0));
     setEntry(parentDir->filename, parentDir, rootDir);
 
     // Writes VCB to block 0
-    int writeVCB = LBAwrite(vcbPtr, 1, 0);
+    int writeVCB = deviceWrite(vcbPtr, 1, 0);
 
-    //Set the allocated blocks to 0 and the directory entry data 
+    //Write the allocated blocks and the directory entry data
     //stored in the hash table
-    setBlocksAsAllocated(vcbPtr->rootDir, DIR_SIZE);
+    writeFreeSpace();
     writeTableData(rootDir, vcbPtr->rootDir);
     workingDir = readTableData(vcbPtr->rootDir);
 
@@ -157,5 +285,9 @@ int initFileSystem(uint64_t numberOfBlocks, uint64_t definedBlockSize) {
 *  exitFileSystem
 ****************************************************/
 void exitFileSystem() {
+  // Make sure the data waiting in the log and every change to the free
+  // space bit vector are on the disk
+  segmentFlush();
+  writeFreeSpace();
   printf("System exiting\n");
 }
\ No newline at end of file
@@ -15,94 +15,88 @@
 **************************************************************/
 
 #include "fs_commands.h"
+#include "blockMap.h"
+#include "b_io.h"
+#include "refTable.h"
+#include "snapshot.h"
+#include "checksum.h"
+#include "segment.h"
 
 //Read all directory entries from a certain disk location into a new hash table
 hashTable* readTableData(int lbaPosition) {
-  //Calculate how many directory entries we will need to have space 
-  //for in the tableData struct
-  int numEntries = (DIR_SIZE * blockSize) / sizeof(dirEntry);
-
-  //Stores all table data written to disk when it is read-in
-  typedef struct tableData {
-    char dirName[20];
-    dirEntry arr[numEntries];
-  } tableData;
-
-  //Read all of the directory entries from the disk into an instance of 
-  //tableData so that it can be loaded into the new hash table
-  tableData* data = malloc(DIR_SIZE * blockSize);
+  //Read the directory's name and all of its directory entry records from
+  //the disk so that they can be loaded into the new hash table
+  char* data = malloc(DIR_SIZE * blockSize);
   if (!data) {
     mallocFailed();
   }
 
-  LBAread(data, DIR_SIZE, lbaPosition);
-
-  dirEntry* arr = data->arr;
+  deviceRead(data, DIR_SIZE, lbaPosition);
 
   //Create a new hash table to be populated
-  hashTable* dirPtr = hashTableInit(data->dirName, ((DIR_SIZE * blockSize) / sizeof(dirEntry) - 1),
+  char dirName[DIR_NAME_SIZE];
+  memcpy(dirName, data, DIR_NAME_SIZE);
+  hashTable* dirPtr = hashTableInit(dirName, MAX_DIR_ENTRIES, DIR_DATA_SIZE,
     lbaPosition);
 
-  //Loop through all entries in arr and add them to the new hash table
-  int i = 0;
   dirEntry* currDirEntry = malloc(sizeof(dirEntry));
   if (!currDirEntry) {
     mallocFailed();
   }
-  currDirEntry = &arr[0];
 
-  while (strcmp(currDirEntry->filename, "") != 0) {
+  //Loop through all of the records and add their entries to the new hash
+  //table. Each record starts with its length and a length of 0 marks the end
+  int pos = DIR_NAME_SIZE;
+  unsigned short recLen;
+  memcpy(&recLen, data + pos, sizeof(recLen));
+
+  while (recLen != 0) {
+    memset(currDirEntry, 0, sizeof(dirEntry));
+    memcpy(currDirEntry, data + pos + sizeof(recLen), recLen - sizeof(recLen));
     setEntry(currDirEntry->filename, currDirEntry, dirPtr);
-    i++;
-    currDirEntry = &arr[i];
+
+    pos += recLen;
+    memcpy(&recLen, data + pos, sizeof(recLen));
   }
 
+  free(currDirEntry);
+  currDirEntry = NULL;
+  free(data);
+  data = NULL;
+
   return dirPtr;
 }
 
 
 //Write all directory entries in the provided hash table to the disk
 void writeTableData(hashTable* table, int lbaPosition) {
-  int numEntries = table->maxNumEntries * sizeof(dirEntry);
-
-  //Stores all table data written to disk when it is read-in
-  typedef struct tableData {
-    char dirName[20];
-    dirEntry arr[numEntries];
-  } tableData;
-
-  //malloc memory for tableData which will be written to disk 
-  //and for arr which will storing all of the directories
-  //found in the hash table
-  tableData* data = calloc(blockSize * DIR_SIZE, 1);
+  //calloc memory for the directory which will be written to disk, the
+  //zeroed bytes after the last record mark the end of the records
+  char* data = calloc(blockSize * DIR_SIZE, 1);
   if (!data) {
     mallocFailed();
   }
 
-  dirEntry* arr = calloc(numEntries, 1);
-  if (!arr) {
-    mallocFailed();
-  }
-
-  //Copy the hash table's name to the tableData object so that it
+  //Copy the hash table's name to the start of the directory so that it
   //can be written to the disk
-  strncpy(data->dirName, table->dirName, strlen(table->dirName));
+  strncpy(data, table->dirName, DIR_NAME_SIZE);
 
-  int j = 0;  //j will track indcies for the array of directory entries
+  int pos = DIR_NAME_SIZE;  //pos tracks where the next record goes
+  int j = 0;  //j will track how many directory entries have been written
 
   //Iterate through the whole table to find every directory entry that is in use
   for (int i = 0; i < SIZE; i++) {
     node* entry = table->entries[i];
-    if (strcmp(entry->value->filename, "") != 0) {
-      arr[j] = *entry->value;
+
+    //add the entry and other entries that are at the same hash location
+    while (entry != NULL && strcmp(entry->value->filename, "") != 0) {
+      unsigned short recLen = dirRecordSize(entry->value);
+      memcpy(data + pos, &recLen, sizeof(recLen));
+      memcpy(data + pos + sizeof(recLen), entry->value, recLen - sizeof(recLen));
+      pos += recLen;
       j++;
 
-      //add other entries that are at the same hash location
-      while (entry->next != NULL) {
-        entry = entry->next;
-        arr[j] = *entry->value;
-        j++;
-      }
+      entry = entry->next;
     }
 
     //Don't bother lookng through rest of table if all entries are found
@@ -111,16 +105,12 @@ void writeTableData(hashTable* table, int lbaPosition) {
     }
   }
 
-  memcpy(data->arr, arr, numEntries);
-
-  //Write the array out to the specified block numbers
-  int val = LBAwrite(data, DIR_SIZE, lbaPosition);
+  //Write the directory out to the specified block numbers
+  int val = deviceWrite(data, DIR_SIZE, lbaPosition);
 
 
   clean(table);
   table = NULL;
-  free(arr);
-  arr = NULL;
   free(data);
   data = NULL;
 }
@@ -265,169 +255,258 @@ deconPath* splitPath(char* fullPath) {
 }
 
 
-int getFreeBlockNum(int getNumBlocks) {
-  int* bitVector = malloc(NUM_FREE_SPACE_BLOCKS * blockSize);
-  if (!bitVector) {
-    mallocFailed();
+// In-memory copy of the free space bit vector. It is read in the first time
+// it is needed and changes to it are kept in memory until writeFreeSpace()
+// writes the blocks of the bit vector that changed back out to the disk
+int* freeSpaceMap = NULL;
+int firstChangedBlock = -1;   //First block of the bit vector that changed
+int lastChangedBlock = -1;    //Last block of the bit vector that changed
+
+//Returns the in-memory copy of the free space bit vector
+int* getFreeSpaceMap() {
+  if (!freeSpaceMap) {
+    freeSpaceMap = malloc(freeSpaceBlocks * blockSize);
+    if (!freeSpaceMap) {
+      mallocFailed();
+    }
+
+    // Read the bitvector
+    deviceRead(freeSpaceMap, freeSpaceBlocks, FREE_SPACE_START_BLOCK);
+  }
+
+  return freeSpaceMap;
+}
+
+//Records which blocks of the bit vector hold the bits of the given clusters
+void markFreeSpaceChanged(int firstCluster, int numClusters) {
+  int bitsPerBlock = blockSize * 8;
+  int first = firstCluster / bitsPerBlock;
+  int last = (firstCluster + numClusters - 1) / bitsPerBlock;
+
+  if (firstChangedBlock == -1 || first < firstChangedBlock) {
+    firstChangedBlock = first;
+  }
+  if (last > lastChangedBlock) {
+    lastChangedBlock = last;
+  }
+}
+
+//Writes the blocks of the free space bit vector that changed out to the disk
+//along with the changes to the cluster reference counts and checksums
+void writeFreeSpace() {
+  writeRefTable();
+  writeChecksumTable();
+
+  if (freeSpaceMap && firstChangedBlock != -1) {
+    int intsPerBlock = blockSize / sizeof(int);
+    deviceWrite(freeSpaceMap + firstChangedBlock * intsPerBlock,
+      lastChangedBlock - firstChangedBlock + 1,
+      FREE_SPACE_START_BLOCK + firstChangedBlock);
+
+    firstChangedBlock = -1;
+    lastChangedBlock = -1;
+  }
+
+  //Blocks a parity volume is holding back must be on the disk before
+  //anything that depends on them is written
+  deviceFlush();
+}
+
+
+//Returns 1 if cluster is free in the free space bit vector
+int clusterIsFree(int cluster) {
+  int* bitVector = getFreeSpaceMap();
+  if (cluster < 0 || cluster >= numOfInts * 32) {
+    return 0;
   }
+  return (bitVector[cluster / 32] & (1 << (31 - cluster % 32))) != 0;
+}
+
+
+//Number of clusters needed to hold numBlocks blocks
+int blocksToClusters(int numBlocks) {
+  return (numBlocks + clusterBlocks - 1) / clusterBlocks;
+}
+
+
+//Stores the first cluster of the fast tier only given to metadata in
+//first and the cluster after the last one in last (both 0 if the volume
+//is not tiered)
+void metadataReserve(int* first, int* last) {
+  int fastClusters = deviceFastBlocks() / clusterBlocks;
+  *first = fastClusters - fastClusters / METADATA_RESERVE;
+  *last = fastClusters;
+}
+
+
+int findFreeBlocks(int getNumBlocks, int metadata) {
+  // Get the bitvector
+  int* bitVector = getFreeSpaceMap();
 
-  // Read the bitvector
-  LBAread(bitVector, NUM_FREE_SPACE_BLOCKS, FREE_SPACE_START_BLOCK);
+  // File data is not given the clusters kept for metadata
+  int reserveFirst = 0;
+  int reserveLast = 0;
+  if (!metadata) {
+    metadataReserve(&reserveFirst, &reserveLast);
+  }
 
-  // This will help determine the first block number that is
+  // This will help determine the first cluster number that is
   // free
-  int freeBlock = -1;
+  int freeCluster = -1;
 
-  // Whenever we find a free block we subtract one from the blocksToFind
-  // and when it reaches 0, we know that we have found the specified
-  // number of contiguous free blocks
-  int blocksToFind = getNumBlocks;
+  // Whenever we find a free cluster we subtract one from the clustersToFind
+  // and when it reaches 0, we know that we have found enough contiguous
+  // free clusters to hold the specified number of blocks
+  int clustersToFind = blocksToClusters(getNumBlocks);
 
-  //****Calculate free space block number*****
-  // We can use the following formula to calculate the block
+  //****Calculate free space cluster number*****
+  // We can use the following formula to calculate the cluster
   // number => (32 * intBlock) + (31 - j), where (32 * intBlock)
   // will give us the number of 32 bit blocks where we found a bit 
   // of value 1 and we add (31 - j) which is a offset to get the 
-  // block number it represents within that 32 bit block
+  // cluster number it represents within that 32 bit block
   for (int i = 0; i < numOfInts; i++) {
     for (int j = 31; j >= 0; j--) {
-      // If the 'if condition' is true that we have found a free block
-      if (bitVector[i] & (1 << j)) {
-        blocksToFind--;
+      int cluster = i * 32 + 31 - j;
+      int reserved = cluster >= reserveFirst && cluster < reserveLast;
+
+      // If the 'if condition' is true that we have found a free cluster
+      if ((bitVector[i] & (1 << j)) && !reserved) {
+        clustersToFind--;
 
-        // If freeBlock is -1 then it means that the first free block
+        // If freeCluster is -1 then it means that the first free cluster
         // has been found, so we calculate it's position in the bitVector
-        if (freeBlock == -1) {
+        if (freeCluster == -1) {
           intBlock = i;
-          freeBlock = (intBlock * 32) + (31 - j);
+          freeCluster = (intBlock * 32) + (31 - j);
         }
 
-        // If the blocksToFind is 0 than we have found the contiguous blocks
-        // that the caller asked for
-        if (blocksToFind == 0) {
-          free(bitVector);
-          bitVector = NULL;
-          return freeBlock;
+        // If the clustersToFind is 0 than we have found the contiguous
+        // clusters that the caller asked for
+        if (clustersToFind == 0) {
+          return freeCluster * clusterBlocks;
         }
       }
 
-      // If the freeBlock is not -1 and the bit is 0 then it means that we have
-      // to start looking for contiguous free blocks again, since we have found a 
-      // block that is not free after finding a block that was free, therefore
-      // blocks are not contiguous
-      else if (freeBlock != -1) {
-        freeBlock = -1;
-        blocksToFind = getNumBlocks;
+      // If the freeCluster is not -1 and the bit is 0 then it means that we
+      // have to start looking for contiguous free clusters again, since we
+      // have found a cluster that is not free after finding one that was
+      // free, therefore clusters are not contiguous
+      else if (freeCluster != -1) {
+        freeCluster = -1;
+        clustersToFind = blocksToClusters(getNumBlocks);
       }
     }
   }
 
   printf("Error: Couldn't find %d contiguous free blocks\n", getNumBlocks);
-  free(bitVector);
-  bitVector = NULL;
   return -1;
 }
 
 
-//Updates the free space bit vector with allocated blocks
-void setBlocksAsAllocated(int freeBlock, int blocksAllocated) {
-  int* bitVector = malloc(NUM_FREE_SPACE_BLOCKS * blockSize);
-  if (!bitVector) {
-    mallocFailed();
-  }
-
-  LBAread(bitVector, NUM_FREE_SPACE_BLOCKS, FREE_SPACE_START_BLOCK);
-
-  freeBlock += 1;
+int getFreeBlockNum(int getNumBlocks) {
+  return findFreeBlocks(getNumBlocks, 0);
+}
 
-  int bitNum = freeBlock - ((intBlock * 32) + 32);
 
-  if (bitNum < 0) {
-    bitNum *= -1;
-  }
+int getMetadataBlockNum(int getNumBlocks) {
+  return findFreeBlocks(getNumBlocks, 1);
+}
 
-  // This will give us the specific bit where we found the free block
-  // in the specific int block
-  bitNum = 32 - bitNum;
 
-  int index = bitNum;
+//Gets the first run of getNumBlocks contiguous free blocks, or the longest
+//shorter run if there is none, and stores the run's length in runLength.
+//Runs are made of whole clusters, so runLength is a multiple of clusterBlocks.
+int getFreeRun(int getNumBlocks, int* runLength) {
+  int* bitVector = getFreeSpaceMap();
+  int getNumClusters = blocksToClusters(getNumBlocks);
+
+  // The longest run of free clusters found so far
+  int bestCluster = -1;
+  int bestLength = 0;
+
+  // The run of free clusters we are currently in
+  int runStart = -1;
+  int length = 0;
+
+  // File data is not given the clusters kept for metadata
+  int reserveFirst;
+  int reserveLast;
+  metadataReserve(&reserveFirst, &reserveLast);
+
+  for (int cluster = 0; cluster < numOfInts * 32; cluster++) {
+    int reserved = cluster >= reserveFirst && cluster < reserveLast;
+    if ((bitVector[cluster / 32] & (1 << (31 - cluster % 32))) && !reserved) {
+      if (runStart == -1) {
+        runStart = cluster;
+        length = 0;
+      }
+      length++;
 
-  // We want to start from the bitnum (index) and go up to the bitNum + 
-  // blocksAllocated while setting the bits to 0, representing that the
-  // corresponding blocks are used
-  int total = (bitNum + blocksAllocated);
+      if (length > bestLength) {
+        bestCluster = runStart;
+        bestLength = length;
+      }
 
-  for (; index < total; index++) {
-    // If we have reached the end of an integer, we move on to the next
-    // integer, and reset the index
-    if (index > 32) {
-      intBlock += 1;
-      index = 1;
-      total -= 32;
+      // Stop as soon as we find a run as long as the caller asked for
+      if (length == getNumClusters) {
+        break;
+      }
+    } else {
+      runStart = -1;
     }
-
-    // We first create a bit mask by shifting 1 to the left, to a
-    // position we want to clear the bit at, calculated using (32 - index)
-    // then we use the not (~) operator to clear the bit at the position given
-    // by (32 - index) and then we apply the mask to our integer, which will 
-    // basically clear the corresponding bit, since 1 & 0 = 0
-    bitVector[intBlock] = bitVector[intBlock] & ~(1 << (32 - index));
   }
 
-  LBAwrite(bitVector, NUM_FREE_SPACE_BLOCKS, 1);
-  free(bitVector);
-  bitVector = NULL;
-}
-
-
-//Updates the free space bit vector with freed blocks
-void setBlocksAsFree(int freeBlock, int blocksFreed) {
-  int* bitVector = malloc(NUM_FREE_SPACE_BLOCKS * blockSize);
-  if (!bitVector) {
-    mallocFailed();
+  if (bestCluster == -1) {
+    printf("Error: Couldn't find a free block\n");
+    *runLength = 0;
+    return -1;
   }
 
-  LBAread(bitVector, NUM_FREE_SPACE_BLOCKS, FREE_SPACE_START_BLOCK);
-
-  freeBlock += 1;
+  *runLength = bestLength * clusterBlocks;
+  return bestCluster * clusterBlocks;
+}
 
-  int bitNum = freeBlock - ((intBlock * 32) + 32);
 
-  if (bitNum < 0) {
-    bitNum *= -1;
+//Updates the free space bit vector with allocated blocks
+void setBlocksAsAllocated(int freeBlock, int blocksAllocated) {
+  int* bitVector = getFreeSpaceMap();
+  int first = freeBlock / clusterBlocks;
+  int last = (freeBlock + blocksAllocated - 1) / clusterBlocks;
+
+  // Cluster c is represented by bit (31 - c % 32) of int c / 32, so we
+  // clear that bit for every cluster in the run, representing that the
+  // corresponding clusters are used
+  for (int cluster = first; cluster <= last; cluster++) {
+    bitVector[cluster / 32] =
+      bitVector[cluster / 32] & ~(1 << (31 - cluster % 32));
   }
 
-  // This will give us the specific bit where
-  // we found the free block in the specific
-  // int block
-  bitNum = 32 - bitNum;
-
-  int index = bitNum;
+  markFreeSpaceChanged(first, last - first + 1);
+}
 
-  // We want to start from the bitnum (index) and go up to the bitNum + 
-  // blocksAllocated while setting the bits to 1, representing that the
-  // corresponding blocks are free
-  int total = (bitNum + blocksFreed);
 
-  for (; index < total; index++) {
-    // If we have reached the end of an integer, we move on to the next
-    // integer, and reset the index
-    if (index > 32) {
-      intBlock += 1;
-      index = 1;
-      total -= 32;
+//Updates the free space bit vector with freed blocks
+void setBlocksAsFree(int freeBlock, int blocksFreed) {
+  int* bitVector = getFreeSpaceMap();
+  int first = freeBlock / clusterBlocks;
+  int last = (freeBlock + blocksFreed - 1) / clusterBlocks;
+
+  // Cluster c is represented by bit (31 - c % 32) of int c / 32, so we
+  // set that bit for every cluster in the run, representing that the
+  // corresponding clusters are free. A cluster shared by other files
+  // only loses a reference, it is freed when the last file drops it.
+  for (int cluster = first; cluster <= last; cluster++) {
+    if (dropRef(cluster)) {
+      continue;
     }
-
-    // We first create a bit mask by shifting 1 to the left, to a
-    // position we want to set the bit at, calculated using (32 - index)
-    // then we apply the mask to our integer, which will 
-    // basically set the corresponding bit
-    bitVector[intBlock] = bitVector[intBlock] | (1 << (32 - index));
+    bitVector[cluster / 32] =
+      bitVector[cluster / 32] | (1 << (31 - cluster % 32));
+    setClusterHash(cluster * clusterBlocks, 0);
+    segmentDiscard(cluster * clusterBlocks, clusterBlocks);
   }
 
-  LBAwrite(bitVector, NUM_FREE_SPACE_BLOCKS, 1);
-  free(bitVector);
-  bitVector = NULL;
+  markFreeSpaceChanged(first, last - first + 1);
 }
 
 
@@ -455,10 +534,19 @@ int fs_stat(const char* path, struct fs_stat* buf) {
   buf->st_size = entry->fileSize;
   printf("Size: \t%ld\n", buf->st_size);
 
-  buf->st_blksize = blockSize;
+  buf->st_blksize = clusterSize;
   printf("IO Block size: \t%ld\n", buf->st_blksize);
 
-  buf->st_blocks = entry->fileSize / blockSize;
+  //A file's holes and inline data take no blocks, so the blocks it
+  //uses are counted from its block map
+  if (entry->isDir) {
+    buf->st_blocks = entry->fileSize / blockSize;
+  } else {
+    blockMap* map = mapLoadEntry(entry);
+    buf->st_blocks = mapUsage(map);
+    mapFree(map);
+    map = NULL;
+  }
   printf("Blocks: \t%ld\n", buf->st_blocks);
 
   //Get and store current time
@@ -510,7 +598,7 @@ int fs_isFile(char* path) {
 // Opens a directory stream corresponding to 'name', and returns
 // a pointer to the directory stream
 fdDir* fs_opendir(const char* name) {
-  fdDir* fdDir = malloc(sizeof(fdDir));
+  fdDir* fdDir = malloc(sizeof(*fdDir));
   if (!fdDir) {
     mallocFailed();
   }
@@ -520,10 +608,10 @@ fdDir* fs_opendir(const char* name) {
   hashTable* dir = getDir((char*)name);
 
   fdDir->dirTable = dir;
-  fdDir->maxIdx = dir->maxNumEntries;
+  fdDir->maxIdx = SIZE;
   fdDir->d_reclen = dir->numEntries;
   fdDir->directoryStartLocation = dir->location;
-  fdDir->dirEntryPosition = dir->maxNumEntries;
+  fdDir->dirEntryPosition = SIZE;
 
   return fdDir;
 }
@@ -602,7 +690,7 @@ hashTable* getDir(char* buf) {
       if (!vcbPtr) {
         mallocFailed();
       }
-      LBAread(vcbPtr, 1, 0);
+      deviceRead(vcbPtr, 1, 0);
       currDir = readTableData(vcbPtr->rootDir);
       free(vcbPtr);
       vcbPtr = NULL;
@@ -753,67 +841,58 @@ char* fs_getcwd(char* buf, size_t size) {
   return path;
 }
 
-//Creates a new directory
-int fs_mkdir(const char* pathname, mode_t mode) {
-  // We call splitPath() to split the given path into 
-  // child and parent path
-  deconPath* pathParts = splitPath((char*)pathname);
-  char* parentPath = pathParts->parentPath;
-
-  // We check if the parent path is valid and is a directory, before
-  // we create a new directory within it
-  if (!fs_isDir(parentPath)) {
-    printf("md: cannot create directory '%s': No such file or directory\n", pathname);
-    free(pathParts);
-    pathParts = NULL;
-    return -1;
-  } else if (fs_isDir((char*)pathname)) {
-    printf("md: cannot create directory '%s': File exists\n", pathname);
-    free(pathParts);
-    pathParts = NULL;
-    return -1;
-  }
-
-  hashTable* parentDir = getDir(parentPath);
-
-  // Create a new directory entry
-  char* newDirName = pathParts->childName;
-
-  int sizeOfEntry = sizeof(dirEntry);	//48 bytes
+//Creates an empty directory called name in parentDir, returning where it
+//starts. The caller writes parentDir and the free space bit vector out.
+int createDir(hashTable* parentDir, char* name) {
   int dirSizeInBytes = (DIR_SIZE * blockSize);	//2560 bytes
-  int maxNumEntries = (dirSizeInBytes / sizeOfEntry) - 1; //52 entries
 
-  dirEntry* newEntry = malloc(sizeof(dirEntry));
+  dirEntry* newEntry = calloc(1, sizeof(dirEntry));
   if (!newEntry) {
     mallocFailed();
   }
 
-  int freeBlock = getFreeBlockNum(DIR_SIZE);
+  int freeBlock = getMetadataBlockNum(DIR_SIZE);
   // Check if the freeBlock returned is valid or not
   if (freeBlock < 0) {
-    free(pathParts);
-    pathParts = NULL;
     free(newEntry);
     newEntry = NULL;
     return -1;
   }
 
+  // Update the bit vector now so that making room in the parent
+  // directory below cannot hand out the same blocks
+  setBlocksAsAllocated(freeBlock, DIR_SIZE);
+
   // Initialize the new directory entry
-  strcpy(newEntry->filename, newDirName);
+  strcpy(newEntry->filename, name);
   newEntry->isDir = 1;
   newEntry->location = freeBlock;
   newEntry->fileSize = DIR_SIZE * blockSize;
   newEntry->dateModified = time(0);
   newEntry->dateCreated = time(0);
 
+  // If inline file data has used up the directory's space, move
+  // some of it out into blocks to make room for the new entry
+  if (!hasRoomFor(name, newEntry, parentDir)) {
+    makeRoomInDir(parentDir, dirRecordSize(newEntry));
+  }
+
   // Put the updated directory entry back
   // into the directory
-  setEntry(newDirName, newEntry, parentDir);
+  if (!setEntry(name, newEntry, parentDir)) {
+    setBlocksAsFree(freeBlock, DIR_SIZE);
+    free(newEntry);
+    newEntry = NULL;
+    return -1;
+  }
+
+  free(newEntry);
+  newEntry = NULL;
 
   // Initialize the directory entries within the new
   // directory
-  int startBlock = getEntry(newDirName, parentDir)->location;
-  hashTable* dirEntries = hashTableInit(newDirName, maxNumEntries, startBlock);
+  hashTable* dirEntries = hashTableInit(name, MAX_DIR_ENTRIES,
+    DIR_DATA_SIZE, freeBlock);
 
   // Initializing the "." current directory and the ".." parent Directory
   dirEntry* currDirEnt = dirEntryInit(".", 1, freeBlock,
@@ -824,16 +903,58 @@ int fs_mkdir(const char* pathname, mode_t mode) {
     dirSizeInBytes, time(0), time(0));
   setEntry(parentDirEnt->filename, parentDirEnt, dirEntries);
 
-  // Write parent directory
-  writeTableData(parentDir, parentDir->location);
   // Write new directory
-  writeTableData(dirEntries, dirEntries->location);
+  writeTableData(dirEntries, freeBlock);
 
-  // Update the bit vector
-  setBlocksAsAllocated(freeBlock, DIR_SIZE);
+  return freeBlock;
+}
+
+//Creates a new directory
+int fs_mkdir(const char* pathname, mode_t mode) {
+  // We call splitPath() to split the given path into 
+  // child and parent path
+  deconPath* pathParts = splitPath((char*)pathname);
+  char* parentPath = pathParts->parentPath;
+
+  // We check if the parent path is valid and is a directory, before
+  // we create a new directory within it
+  if (!fs_isDir(parentPath)) {
+    printf("md: cannot create directory '%s': No such file or directory\n", pathname);
+    free(pathParts);
+    pathParts = NULL;
+    return -1;
+  } else if (fs_isDir((char*)pathname)) {
+    printf("md: cannot create directory '%s': File exists\n", pathname);
+    free(pathParts);
+    pathParts = NULL;
+    return -1;
+  }
+
+  hashTable* parentDir = getDir(parentPath);
+
+  // Nothing can be added to a snapshot
+  if (inSnapshot(parentDir->location)) {
+    printf("md: cannot create directory '%s': Snapshots are read-only\n", pathname);
+    free(pathParts);
+    pathParts = NULL;
+    clean(parentDir);
+    return -1;
+  }
+
+  if (createDir(parentDir, pathParts->childName) < 0) {
+    writeFreeSpace();
+    free(pathParts);
+    pathParts = NULL;
+    clean(parentDir);
+    return -1;
+  }
+
+  // Write the updated bit vector
+  writeFreeSpace();
+
+  // Write parent directory
+  writeTableData(parentDir, parentDir->location);
 
-  free(newEntry);
-  newEntry = NULL;
   free(pathParts);
   pathParts = NULL;
 
@@ -861,9 +982,14 @@ int fs_rmdir(const char* pathname) {
   //Get the parent directory
   hashTable* parentDir = getDir(parentPath);
 
-  int sizeOfEntry = sizeof(dirEntry);	//48 bytes
-  int dirSizeInBytes = (DIR_SIZE * blockSize);	//2560 bytes
-  int maxNumEntries = (dirSizeInBytes / sizeOfEntry) - 1; //52 entries
+  //Nothing can be removed from a snapshot
+  if (inSnapshot(parentDir->location)) {
+    printf("rm: cannot remove directory '%s': Snapshots are read-only\n", pathname);
+    free(pathParts);
+    pathParts = NULL;
+    clean(parentDir);
+    return -1;
+  }
 
   //Gather details of directory to remove
   char* dirNameToRemove = pathParts->childName;
@@ -909,6 +1035,7 @@ int fs_rmdir(const char* pathname) {
 
   //Update the free space bit vector
   setBlocksAsFree(dirToRemoveLocation, DIR_SIZE);
+  writeFreeSpace();
 
   free(pathParts);
   pathParts = NULL;
@@ -923,34 +1050,24 @@ int fs_delete(char* filename) {
   deconPath* pathParts = splitPath((char*)filename);
   hashTable* parentDir = getDir(pathParts->parentPath);
 
+  //Nothing can be removed from a snapshot
+  if (inSnapshot(parentDir->location)) {
+    printf("rm: cannot remove '%s': Snapshots are read-only\n", filename);
+    free(pathParts);
+    pathParts = NULL;
+    clean(parentDir);
+    return -1;
+  }
+
   char* fileNameToRemove = pathParts->childName;
   dirEntry* dirEntry = getEntry(pathParts->childName, parentDir);
-  int fileToRemoveLocation = dirEntry->location;
-
-  int blockToFree = dirEntry->location;
-
-  //Iterate over each file block to get all associated block nums
-  while (blockToFree) {
-    //Set each block num as free
-    setBlocksAsFree(blockToFree, 1);
 
-    char* buffer = malloc(blockSize);
-    LBAread(buffer, 1, blockToFree);
-
-    char blockChars[6];
-
-    for (int j = 0; j < 5; j++) {
-      blockChars[j] = buffer[j];
-    }
-    blockChars[5] = '\0';
-
-    // Convert the characters representing block number to
-    // an integer
-    const char* constBlockNumbs = blockChars;
-    blockToFree = atoi(constBlockNumbs);
-    free(buffer);
-    buffer = NULL;
-  }
+  //Free every data block and map block associated with the file
+  blockMap* map = mapLoadEntry(dirEntry);
+  mapRelease(map);
+  mapFree(map);
+  map = NULL;
+  writeFreeSpace();
 
   //Remove dirEntry from the parent dir
   rmEntry(fileNameToRemove, parentDir);
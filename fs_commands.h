@@ -25,12 +25,31 @@
 #include <string.h>
 #include <time.h>
 #include "fsLow.h"
+#include "device.h"
 #include "mfs.h"
 
-#define SIG 90981  //Volume signature
+#define SIG 90982  //Volume signature
+#define OLD_SIG 90981  //Signature of volumes that keep block links inside data blocks
 #define FREE_SPACE_START_BLOCK 1
-#define NUM_FREE_SPACE_BLOCKS 5
+#define NUM_FREE_SPACE_BLOCKS 5  //Fewest blocks the free space bit vector takes
 #define DIR_SIZE 5
+#define MAX_CLUSTER_SIZE (1024 * 1024)  //Largest cluster a volume can use
+
+//1 in METADATA_RESERVE of the clusters at the end of the fast tier of a
+//tiered volume are only given to metadata, so block maps, directories and
+//tables stay on the fast tier when file data fills it
+#define METADATA_RESERVE 16
+
+//Bytes of a directory available for entry records, which is what is left
+//after the directory's name and the empty record that marks the end
+#define DIR_DATA_SIZE (DIR_SIZE * blockSize - DIR_NAME_SIZE - sizeof(unsigned short))
+
+//Most entries a directory can hold when none of them keep data inline
+#define MAX_DIR_ENTRIES (DIR_DATA_SIZE / DIR_RECORD_SIZE)
+
+//File data blocks hold only file bytes and the links between them
+//are kept out of band in each file's block map (see blockMap.h)
+#define LAYOUT_BLOCK_MAP 1
 
 struct volumeCtrlBlock {
   long signature;      //Marker left behind that can be checked
@@ -40,12 +59,55 @@ struct volumeCtrlBlock {
   long numFreeBlocks;  //The number of blocks not in use
   int rootDir;		     //Block number where root starts
   int freeBlockNum;    //To store the block number where our bitmap starts
+  int layout;          //How file data is laid out on the volume
+  int clusterBlocks;   //The number of blocks in each allocation cluster
+  int compression;     //1 if new files are stored compressed
+  int refTable;        //Block number where the cluster reference counts start
+  int dedupTable;      //Block number where the cluster hashes start
+                       //(0 if the volume does not deduplicate data)
+  int checksumTable;   //Block number where the cluster checksums start
+                       //(0 if the volume does not checksum data)
+  int logStructured;   //1 if changed file data is appended to a log
+  long fastBlocks;     //The number of blocks on the fast volume file
+                       //(0 if the volume is a single volume file)
+  int stripeFiles;     //The number of volume files the volume is striped
+                       //across (0 if the volume is not striped)
+  int stripeBlocks;    //The number of blocks in each stripe unit
+  int parity;          //1 if each stripe has a unit of parity
+  int mirrored;        //1 if the volume is mirrored onto a second volume file
+  int freeSpaceBlocks; //The number of blocks the free space bit vector takes
+                       //(0 for volumes from before it grew with the volume,
+                       //which use NUM_FREE_SPACE_BLOCKS)
 } volumeCtrlBlock;
 
 // Pointer to our root directory (hash table of directory entries)
 hashTable* workingDir;
 int blockSize;
 int numOfInts;
+int freeSpaceBlocks;  //Number of blocks the free space bit vector takes
+
+// Space is allocated in clusters of clusterBlocks blocks (clusterSize
+// bytes). The free space bit vector has one bit per cluster and file data
+// is read and written a cluster at a time, while LBAread and LBAwrite are
+// still given block numbers and block counts.
+int clusterBlocks;
+int clusterSize;
+
+// Cluster size in bytes that a new volume is formatted with (0 = one block)
+int formatClusterSize;
+
+// 1 if new files are stored compressed. A new volume is formatted with
+// this setting, and mounting a volume sets it to the volume's setting.
+int compressFiles;
+
+// 1 if a new volume is formatted to store identical full data clusters
+// only once
+int formatDedup;
+
+// 1 if changed file data is appended to a log instead of being written
+// back in place (see segment.h). A new volume is formatted with this
+// setting, and mounting a volume sets it to the volume's setting.
+int logStructured;
 
 // This will help us determine the int block in which we found a bit of 
 // value 1 representing free block
@@ -65,13 +127,53 @@ int isDirWithValidPath(char* path);
 //(Seperates the parent path from the last element in the path)
 deconPath* splitPath(char* fullPath);
 
-//Gets the next available block number that is not in use
+//Returns the in-memory copy of the free space bit vector
+int* getFreeSpaceMap();
+
+//Records which blocks of the bit vector hold the bits of the given clusters
+void markFreeSpaceChanged(int firstCluster, int numClusters);
+
+//Writes the blocks of the free space bit vector that changed out to the disk
+void writeFreeSpace();
+
+//Returns 1 if cluster is free in the free space bit vector
+int clusterIsFree(int cluster);
+
+//Number of clusters needed to hold numBlocks blocks
+int blocksToClusters(int numBlocks);
+
+//Stores the first cluster of the fast tier only given to metadata in
+//first and the cluster after the last one in last (both 0 if the volume
+//is not tiered)
+void metadataReserve(int* first, int* last);
+
+//Gets the first block of getNumBlocks contiguous free blocks for file data,
+//or of metadata if metadata is 1, which can also use the clusters kept for
+//it. The block returned is always the first block of a cluster.
+int findFreeBlocks(int getNumBlocks, int metadata);
+
+//Gets the next available block number that is not in use for file data.
+//The block returned is always the first block of a cluster.
 int getFreeBlockNum(int getNumBlocks);
 
-//Updates the free space bit vector with allocated blocks
+//Gets the next available block number that is not in use for a block
+//map, directory, or table, which goes on the fast tier of a tiered volume
+//while there is room for it. The block returned is always the first block
+//of a cluster.
+int getMetadataBlockNum(int getNumBlocks);
+
+//Gets the first run of getNumBlocks contiguous free blocks for file data,
+//or the longest shorter run if there is none, and stores the run's length
+//in runLength. Runs are made of whole clusters, so runLength is a multiple
+//of clusterBlocks.
+int getFreeRun(int getNumBlocks, int* runLength);
+
+//Updates the free space bit vector with allocated blocks (every cluster
+//the blocks touch is allocated)
 void setBlocksAsAllocated(int freeBlock, int blocksAllocated);
 
-//Updates the free space bit vector with freed blocks
+//Updates the free space bit vector with freed blocks (every cluster the
+//blocks touch is freed)
 void setBlocksAsFree(int freeBlock, int blocksFreed);
 
 //Displays file details associated with the file system
@@ -108,6 +210,9 @@ int fs_setcwd(char* buf);
 //Gets the current working directory
 char* fs_getcwd(char* buf, size_t size);
 
+//Creates an empty directory called name in parentDir, returning where it
+//starts. The caller writes parentDir and the free space bit vector out.
+int createDir(hashTable* parentDir, char* name);
 //Creates a new directory
 int fs_mkdir(const char* pathname, mode_t mode);
 
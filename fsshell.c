@@ -21,8 +21,14 @@
 #include <readline/history.h>
 #include <getopt.h>
 #include <string.h>
+#include <limits.h>
 #include "mfs.h"
 #include "b_io.h"
+#include "snapshot.h"
+#include "scrub.h"
+#include "defrag.h"
+#include "segment.h"
+#include "tier.h"
 #include "fsLow.h"
 
 #define PERMISSIONS (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH)
@@ -42,6 +48,12 @@
 #define CMDCP2FS_ON	1
 #define CMDCD_ON	1
 #define CMDPWD_ON	1
+#define CMDSNAP_ON	1
+#define CMDSCRUB_ON	1
+#define CMDDEFRAG_ON	1
+#define CMDCLEAN_ON	1
+#define CMDTIER_ON	1
+#define CMDRESYNC_ON	1
 
 
 typedef struct dispatch_t {
@@ -60,6 +72,12 @@ int cmd_cp2l(int argcnt, char* argvec[]);
 int cmd_cp2fs(int argcnt, char* argvec[]);
 int cmd_cd(int argcnt, char* argvec[]);
 int cmd_pwd(int argcnt, char* argvec[]);
+int cmd_snap(int argcnt, char* argvec[]);
+int cmd_scrub(int argcnt, char* argvec[]);
+int cmd_defrag(int argcnt, char* argvec[]);
+int cmd_clean(int argcnt, char* argvec[]);
+int cmd_tier(int argcnt, char* argvec[]);
+int cmd_resync(int argcnt, char* argvec[]);
 int cmd_history(int argcnt, char* argvec[]);
 int cmd_help(int argcnt, char* argvec[]);
 
@@ -73,6 +91,12 @@ dispatch_t dispatchTable[] = {
   {"cp2fs", cmd_cp2fs, "Copies a file from the Linux file system to the test file system"},
   {"cd", cmd_cd, "Changes directory"},
   {"pwd", cmd_pwd, "Prints the working directory"},
+  {"snap", cmd_snap, "Takes a read-only snapshot - name, or removes one - -d name"},
+  {"scrub", cmd_scrub, "Checks every file's data against its checksums - [threads]"},
+  {"defrag", cmd_defrag, "Moves fragmented files into contiguous runs - [MB per second]"},
+  {"clean", cmd_clean, "Frees whole segments of a log-structured volume - [segments]"},
+  {"tier", cmd_tier, "Moves hot data to the fast tier and cold data to the slow tier"},
+  {"resync", cmd_resync, "Copies the out of date parts of a mirrored or parity volume"},
   {"history", cmd_history, "Prints out the history"},
   {"help", cmd_help, "Prints out help"}
 };
@@ -219,8 +243,7 @@ int cmd_cp(int argcnt, char* argvec[]) {
   int testfs_dest_fd;
   char* src;
   char* dest;
-  int readcnt;
-  char buf[BUFFERLEN];
+  off_t srcSize;
 
   switch (argcnt) {
     case 2:	//only one name provided
@@ -239,12 +262,27 @@ int cmd_cp(int argcnt, char* argvec[]) {
   }
 
 
+  // The copy shares the source's blocks, which takes no copying of data,
+  // unless the volume cannot share blocks
+  if (b_reflink(src, dest) == 0) {
+    return 0;
+  }
+
+  // Otherwise the data is copied inside the volume a run of blocks at
+  // a time
   testfs_src_fd = b_open(src, O_RDONLY);
+  if (testfs_src_fd < 0) {
+    return (-1);
+  }
   testfs_dest_fd = b_open(dest, O_WRONLY | O_CREAT | O_TRUNC);
-  do {
-    readcnt = b_read(testfs_src_fd, buf, BUFFERLEN);
-    b_write(testfs_dest_fd, buf, readcnt);
-  } while (readcnt == BUFFERLEN);
+  if (testfs_dest_fd < 0) {
+    b_close(testfs_src_fd);
+    return (-1);
+  }
+  srcSize = b_seek(testfs_src_fd, 0, SEEK_END);
+  if (b_copy_range(testfs_src_fd, 0, testfs_dest_fd, 0, srcSize) != srcSize) {
+    printf("Error: could not copy all of %s\n", src);
+  }
   b_close(testfs_src_fd);
   b_close(testfs_dest_fd);
 #endif
@@ -523,6 +561,122 @@ int cmd_pwd(int argcnt, char* argvec[]) {
   return 0;
 }
 
+/****************************************************
+*  Snapshot commmand
+****************************************************/
+int cmd_snap(int argcnt, char* argvec[]) {
+#if (CMDSNAP_ON == 1)
+  if (argcnt == 2) {
+    return fs_snapshot(argvec[1]);
+  } else if (argcnt == 3 && strcmp(argvec[1], "-d") == 0) {
+    return fs_rmsnapshot(argvec[2]);
+  }
+
+  printf("Usage: snap name | snap -d name\n");
+#endif
+  return -1;
+}
+
+/****************************************************
+*  Scrub commmand
+****************************************************/
+int cmd_scrub(int argcnt, char* argvec[]) {
+#if (CMDSCRUB_ON == 1)
+  // By default there is a thread for every processor
+  int numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (argcnt == 2) {
+    numThreads = atoi(argvec[1]);
+  } else if (argcnt != 1) {
+    printf("Usage: scrub [threads]\n");
+    return -1;
+  }
+
+  return fs_scrub(numThreads) == 0 ? 0 : -1;
+#endif
+  return -1;
+}
+
+/****************************************************
+*  Defrag commmand
+****************************************************/
+int cmd_defrag(int argcnt, char* argvec[]) {
+#if (CMDDEFRAG_ON == 1)
+  // By default the defrag moves data as fast as it can
+  long bytesPerSecond = 0;
+
+  if (argcnt == 2) {
+    bytesPerSecond = (long)(atof(argvec[1]) * 1024 * 1024);
+  } else if (argcnt != 1) {
+    printf("Usage: defrag [MB per second]\n");
+    return -1;
+  }
+
+  fs_defrag(bytesPerSecond);
+  return 0;
+#endif
+  return -1;
+}
+
+/****************************************************
+*  Clean commmand
+****************************************************/
+int cmd_clean(int argcnt, char* argvec[]) {
+#if (CMDCLEAN_ON == 1)
+  // By default the cleaner frees as many segments as it can
+  int maxSegments = INT_MAX;
+
+  if (argcnt == 2) {
+    maxSegments = atoi(argvec[1]);
+  } else if (argcnt != 1) {
+    printf("Usage: clean [segments]\n");
+    return -1;
+  }
+
+  if (fs_clean(maxSegments) == 0) {
+    printf("No segments to clean\n");
+  }
+  return 0;
+#endif
+  return -1;
+}
+
+/****************************************************
+*  Tier commmand
+****************************************************/
+int cmd_tier(int argcnt, char* argvec[]) {
+#if (CMDTIER_ON == 1)
+  if (argcnt != 1) {
+    printf("Usage: tier\n");
+    return -1;
+  }
+
+  fs_tier();
+  return 0;
+#endif
+  return -1;
+}
+
+/****************************************************
+*  Resync commmand
+****************************************************/
+int cmd_resync(int argcnt, char* argvec[]) {
+#if (CMDRESYNC_ON == 1)
+  if (argcnt != 1) {
+    printf("Usage: resync\n");
+    return -1;
+  }
+
+  int copied = deviceResync();
+  if (copied >= 0) {
+    printf("Copied %d out of date %s\n", copied,
+      deviceParity() ? "stripes" : "regions");
+  }
+  return 0;
+#endif
+  return -1;
+}
+
 /****************************************************
 *  History commmand
 ****************************************************/
@@ -656,15 +810,65 @@ int main(int argc, char* argv[]) {
   uint64_t blockSize;
   int retVal;
 
-  if (argc > 3) {
-    filename = argv[1];
-    volumeSize = atoll(argv[2]);
-    blockSize = atoll(argv[3]);
+  // -z formats a new volume to store new files compressed, -d formats
+  // it to store identical full blocks of data only once, and -l formats
+  // it to append changed data to a log. -t adds a slow volume file behind
+  // the volume file, which is then the fast tier, and -s gives the size
+  // the slow volume file is created with. Each -a adds a volume file the
+  // volume is striped across, and -u gives the size of a stripe unit. -p
+  // keeps a unit of parity in each stripe, which needs at least two -a.
+  // -m mirrors the volume file onto a second volume file.
+  char* slowFilename = NULL;
+  char* mirrorFilename = NULL;
+  int parity = 0;
+  uint64_t slowSize = 0;
+  char* stripeFilenames[DEVICE_MAX_FILES];
+  int numStripeFiles = 0;
+  uint64_t stripeUnit = 64 * 1024;
+  int opt;
+  while ((opt = getopt(argc, argv, "zdlt:s:a:u:pm:")) != -1) {
+    if (opt == 'z') {
+      compressFiles = 1;
+    } else if (opt == 'd') {
+      formatDedup = 1;
+    } else if (opt == 'l') {
+      logStructured = 1;
+    } else if (opt == 't') {
+      slowFilename = optarg;
+    } else if (opt == 's') {
+      slowSize = atoll(optarg);
+    } else if (opt == 'a' && numStripeFiles < DEVICE_MAX_FILES - 1) {
+      stripeFilenames[numStripeFiles++] = optarg;
+    } else if (opt == 'u') {
+      stripeUnit = atoll(optarg);
+    } else if (opt == 'p') {
+      parity = 1;
+    } else if (opt == 'm') {
+      mirrorFilename = optarg;
+    } else {
+      argc = 0;   //print the usage
+    }
+  }
+
+  // A volume is only one of tiered, striped, or mirrored
+  int layouts = (slowFilename != NULL) + (numStripeFiles > 0) +
+    (mirrorFilename != NULL);
+  if (argc - optind > 2 && layouts < 2 && (!parity || numStripeFiles)) {
+    filename = argv[optind];
+    volumeSize = atoll(argv[optind + 1]);
+    blockSize = atoll(argv[optind + 2]);
   } else {
-    printf("Usage: fsLowDriver volumeFileName volumeSize blockSize\n");
+    printf("Usage: fsLowDriver [-z] [-d] [-l] [-t slowVolumeFileName "
+      "[-s slowVolumeSize] | -a stripeVolumeFileName ... [-u stripeUnit] [-p] | "
+      "-m mirrorVolumeFileName] volumeFileName volumeSize blockSize [clusterSize]\n");
     return -1;
   }
 
+  // The cluster size is only used when a new volume is formatted
+  if (argc - optind > 3) {
+    formatClusterSize = atoi(argv[optind + 3]);
+  }
+
   retVal = startPartitionSystem(filename, &volumeSize, &blockSize);
   printf("Opened %s, Volume Size: %llu;  BlockSize: %llu; Return %d\n", filename, (ull_t)volumeSize, (ull_t)blockSize, retVal);
 
@@ -673,10 +877,63 @@ int main(int argc, char* argv[]) {
     return (retVal);
   }
 
-  retVal = initFileSystem(volumeSize / blockSize, blockSize);
+  // The blocks of the slow volume file come after those of the volume
+  // file. Unless -s says otherwise, a new slow volume file is created the
+  // same size as the volume file.
+  uint64_t numBlocks = volumeSize / blockSize;
+  if (slowFilename) {
+    uint64_t slowBlocks = (slowSize ? slowSize : volumeSize) / blockSize;
+    if (deviceAddSlowTier(slowFilename, &slowBlocks, numBlocks,
+      blockSize) < 0) {
+      closePartitionSystem();
+      return -1;
+    }
+    printf("Opened %s, Slow Volume Size: %llu\n", slowFilename,
+      (ull_t)(slowBlocks * blockSize));
+    numBlocks += slowBlocks;
+  }
+
+  // New stripe volume files are created the same size as the volume file
+  if (numStripeFiles) {
+    uint64_t unitBlocks = stripeUnit / blockSize;
+    if (unitBlocks == 0 || stripeUnit % blockSize) {
+      printf("Error: the stripe unit must be a multiple of the block "
+        "size\n");
+      closePartitionSystem();
+      return -1;
+    }
+    int stripeResult = parity ?
+      deviceAddParity(stripeFilenames, numStripeFiles, numBlocks,
+      blockSize, unitBlocks, &numBlocks) :
+      deviceAddStripes(stripeFilenames, numStripeFiles, numBlocks,
+      blockSize, unitBlocks, &numBlocks);
+    if (stripeResult < 0) {
+      deviceClose();
+      closePartitionSystem();
+      return -1;
+    }
+    printf("Striped across %d volume files%s, Stripe Unit: %llu; "
+      "Volume Size: %llu\n", numStripeFiles + 1, parity ? " with parity" : "",
+      (ull_t)stripeUnit, (ull_t)(numBlocks * blockSize));
+  }
+
+  // A new mirror volume file is created the same size as the volume file
+  if (mirrorFilename) {
+    if (deviceAddMirror(mirrorFilename, numBlocks, blockSize,
+      &numBlocks) < 0) {
+      deviceClose();
+      closePartitionSystem();
+      return -1;
+    }
+    printf("Mirrored onto %s, Volume Size: %llu\n", mirrorFilename,
+      (ull_t)(numBlocks * blockSize));
+  }
+
+  retVal = initFileSystem(numBlocks, blockSize);
 
   if (retVal != 0) {
     printf("Initialize File System Failed:  %d\n", retVal);
+    deviceClose();
     closePartitionSystem();
     return (retVal);
   }
@@ -704,6 +961,7 @@ int main(int argc, char* argv[]) {
       free(cmd);
       cmd = NULL;
       exitFileSystem();
+      deviceClose();
       closePartitionSystem();
       // exit while loop and terminate shell
       break;
@@ -715,6 +973,12 @@ int main(int argc, char* argv[]) {
         add_history(cmd);
       }
       processcommand(cmd);
+
+      // The tier mover runs between commands, moving clusters to the
+      // tier that suits how much they have been used lately
+      int promoted;
+      int demoted;
+      tierMove(&promoted, &demoted);
     }
 
     free(cmd);
@@ -0,0 +1,217 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: lzCodec.c
+*
+* Description: This file holds the LZ codec used to compress the
+* chunks of compressed files.
+*
+* Every sequence starts with a token byte. Its high 4 bits are the
+* number of literal bytes and its low 4 bits are the match length
+* minus LZ_MIN_MATCH. A value of 15 in either means more length bytes
+* follow, each added on until one is less than 255. The literals come
+* next, then the 2 byte (little endian) distance back to the match.
+* The last sequence has only literals.
+*
+**************************************************************/
+
+#include <string.h>
+#include <stdint.h>
+#include "lzCodec.h"
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_DISTANCE 65535
+#define LZ_HASH_BITS 12
+#define LZ_HASH_SIZE (1 << LZ_HASH_BITS)
+
+//Writes the extra bytes of a length that did not fit in its 4 bits
+int writeLength(unsigned char* dst, int op, int dstCap, int length) {
+  while (length >= 255) {
+    if (op >= dstCap) {
+      return -1;
+    }
+    dst[op++] = 255;
+    length -= 255;
+  }
+
+  if (op >= dstCap) {
+    return -1;
+  }
+  dst[op++] = length;
+  return op;
+}
+
+//Writes a sequence of numLiterals literals followed by a match of
+//matchLen bytes distance bytes back (matchLen 0 = no match)
+int writeSequence(unsigned char* dst, int op, int dstCap,
+  const unsigned char* literals, int numLiterals, int distance, int matchLen) {
+  if (op >= dstCap) {
+    return -1;
+  }
+
+  int token = op++;
+  int litCode = numLiterals < 15 ? numLiterals : 15;
+  int matchCode = 0;
+  if (matchLen) {
+    matchCode = matchLen - LZ_MIN_MATCH < 15 ? matchLen - LZ_MIN_MATCH : 15;
+  }
+  dst[token] = (litCode << 4) | matchCode;
+
+  if (litCode == 15) {
+    op = writeLength(dst, op, dstCap, numLiterals - 15);
+    if (op < 0) {
+      return -1;
+    }
+  }
+
+  if (op + numLiterals > dstCap) {
+    return -1;
+  }
+  memcpy(dst + op, literals, numLiterals);
+  op += numLiterals;
+
+  if (!matchLen) {
+    return op;
+  }
+
+  if (op + 2 > dstCap) {
+    return -1;
+  }
+  dst[op++] = distance & 0xFF;
+  dst[op++] = distance >> 8;
+
+  if (matchCode == 15) {
+    op = writeLength(dst, op, dstCap, matchLen - LZ_MIN_MATCH - 15);
+  }
+  return op;
+}
+
+//Reads the extra bytes of a length whose 4 bits were all set
+int readLength(const unsigned char* src, int* ip, int srcLen) {
+  int length = 0;
+  int byte;
+  do {
+    if (*ip >= srcLen) {
+      return -1;
+    }
+    byte = src[(*ip)++];
+    length += byte;
+  } while (byte == 255);
+
+  return length;
+}
+
+//Compresses srcLen bytes of src into dst, returning the compressed length
+//or -1 if it does not fit in dstCap bytes
+int lzCompress(const char* source, int srcLen, char* dest, int dstCap) {
+  const unsigned char* src = (const unsigned char*)source;
+  unsigned char* dst = (unsigned char*)dest;
+
+  //Position of the last place each hash of 4 bytes was seen
+  int table[LZ_HASH_SIZE];
+  for (int i = 0; i < LZ_HASH_SIZE; i++) {
+    table[i] = -1;
+  }
+
+  int ip = 0;       //Position in the input
+  int anchor = 0;   //Start of the literals not written yet
+  int op = 0;       //Position in the output
+
+  while (ip + LZ_MIN_MATCH <= srcLen) {
+    uint32_t sequence;
+    memcpy(&sequence, src + ip, sizeof(sequence));
+    int hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+    int ref = table[hash];
+    table[hash] = ip;
+
+    if (ref < 0 || ip - ref > LZ_MAX_DISTANCE ||
+      memcmp(src + ref, src + ip, LZ_MIN_MATCH) != 0) {
+      ip++;
+      continue;
+    }
+
+    int matchLen = LZ_MIN_MATCH;
+    while (ip + matchLen < srcLen && src[ref + matchLen] == src[ip + matchLen]) {
+      matchLen++;
+    }
+
+    op = writeSequence(dst, op, dstCap, src + anchor, ip - anchor,
+      ip - ref, matchLen);
+    if (op < 0) {
+      return -1;
+    }
+
+    ip += matchLen;
+    anchor = ip;
+  }
+
+  return writeSequence(dst, op, dstCap, src + anchor, srcLen - anchor, 0, 0);
+}
+
+//Decompresses srcLen bytes of src into dst, returning the decompressed
+//length or -1 if the data is corrupt or does not fit in dstCap bytes
+int lzDecompress(const char* source, int srcLen, char* dest, int dstCap) {
+  const unsigned char* src = (const unsigned char*)source;
+  unsigned char* dst = (unsigned char*)dest;
+
+  int ip = 0;
+  int op = 0;
+
+  while (ip < srcLen) {
+    int token = src[ip++];
+
+    int numLiterals = token >> 4;
+    if (numLiterals == 15) {
+      int extra = readLength(src, &ip, srcLen);
+      if (extra < 0) {
+        return -1;
+      }
+      numLiterals += extra;
+    }
+
+    if (ip + numLiterals > srcLen || op + numLiterals > dstCap) {
+      return -1;
+    }
+    memcpy(dst + op, src + ip, numLiterals);
+    ip += numLiterals;
+    op += numLiterals;
+
+    //The last sequence has no match
+    if (ip == srcLen) {
+      break;
+    }
+
+    if (ip + 2 > srcLen) {
+      return -1;
+    }
+    int distance = src[ip] | (src[ip + 1] << 8);
+    ip += 2;
+
+    int matchLen = (token & 15) + LZ_MIN_MATCH;
+    if ((token & 15) == 15) {
+      int extra = readLength(src, &ip, srcLen);
+      if (extra < 0) {
+        return -1;
+      }
+      matchLen += extra;
+    }
+
+    if (distance == 0 || distance > op || op + matchLen > dstCap) {
+      return -1;
+    }
+
+    //The match may overlap the bytes it is producing, so it is copied
+    //a byte at a time
+    for (int i = 0; i < matchLen; i++) {
+      dst[op + i] = dst[op - distance + i];
+    }
+    op += matchLen;
+  }
+
+  return op;
+}
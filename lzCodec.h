@@ -0,0 +1,28 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: lzCodec.h
+*
+* Description: This file holds the prototypes of the LZ codec used
+* to compress the chunks of compressed files. The format is a byte
+* oriented LZ77 in the style of LZ4: a sequence of literal runs, each
+* followed by a back reference of up to 64 KiB into the output.
+*
+**************************************************************/
+#ifndef LZCODEC_H
+#define LZCODEC_H
+
+//Compresses srcLen bytes of src into dst, returning the compressed length
+//or -1 if it does not fit in dstCap bytes
+int lzCompress(const char* src, int srcLen, char* dst, int dstCap);
+
+//Decompresses srcLen bytes of src into dst, returning the decompressed
+//length or -1 if the data is corrupt or does not fit in dstCap bytes
+int lzDecompress(const char* src, int srcLen, char* dst, int dstCap);
+
+#endif
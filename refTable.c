@@ -0,0 +1,314 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: refTable.c
+*
+* Description: This file holds the functions that keep track of
+* clusters shared by more than one file, and the index used to find
+* clusters that already hold a given cluster of data.
+*
+**************************************************************/
+
+#include "refTable.h"
+#include "segment.h"
+
+//Number of extra references to each cluster (unsigned short per cluster)
+diskTable refs = { NULL, 0, 0, -1, -1 };
+
+//Content hash of each full data cluster (uint64_t per cluster, 0 = none)
+diskTable hashes = { NULL, 0, 0, -1, -1 };
+
+int tableClusters = 0;    //Number of clusters the tables have entries for
+
+//Index from a hash to the clusters that have it, built in memory the
+//first time a duplicate is looked for
+int* hashBuckets = NULL;  //First cluster in each bucket (-1 = none)
+int* hashNext = NULL;     //Next cluster in the same bucket (-1 = none)
+int numBuckets = 0;       //Always a power of two
+
+//Number of blocks a table with entrySize bytes per cluster takes up
+int tableBlocks(int numClusters, int entrySize) {
+  return ((long)numClusters * entrySize + blockSize - 1) / blockSize;
+}
+
+//Returns the in-memory copy of a table
+char* tableData(diskTable* table) {
+  if (!table->data) {
+    table->data = malloc(table->numBlocks * blockSize);
+    if (!table->data) {
+      mallocFailed();
+    }
+    deviceRead(table->data, table->numBlocks, table->location);
+  }
+
+  return table->data;
+}
+
+//Records which blocks of a table hold the entry of a cluster
+void tableChanged(diskTable* table, int cluster, int entrySize) {
+  int block = ((long)cluster * entrySize) / blockSize;
+
+  if (table->firstChanged == -1 || block < table->firstChanged) {
+    table->firstChanged = block;
+  }
+  if (block > table->lastChanged) {
+    table->lastChanged = block;
+  }
+}
+
+//Writes the blocks of a table that changed out to the disk
+void writeTable(diskTable* table) {
+  if (!table->data || table->firstChanged == -1) {
+    return;
+  }
+
+  deviceWrite(table->data + table->firstChanged * blockSize,
+    table->lastChanged - table->firstChanged + 1,
+    table->location + table->firstChanged);
+
+  table->firstChanged = -1;
+  table->lastChanged = -1;
+}
+
+//Allocates and zeroes a table of numBlocks blocks, returning where it starts
+int createTable(int numBlocks) {
+  int freeBlock = getMetadataBlockNum(numBlocks);
+  // Check if the freeBlock returned is valid or not
+  if (freeBlock < 0) {
+    return -1;
+  }
+  setBlocksAsAllocated(freeBlock, numBlocks);
+
+  char* zeros = calloc(numBlocks, blockSize);
+  if (!zeros) {
+    mallocFailed();
+  }
+  deviceWrite(zeros, numBlocks, freeBlock);
+  free(zeros);
+  zeros = NULL;
+
+  return freeBlock;
+}
+
+//Creates the tables of a new volume with numClusters clusters and stores
+//where they start in refLoc and dedupLoc (dedupLoc is 0 unless withDedup)
+int refTableCreate(int numClusters, int withDedup, int* refLoc, int* dedupLoc) {
+  *refLoc = createTable(tableBlocks(numClusters, sizeof(unsigned short)));
+  *dedupLoc = 0;
+  if (*refLoc < 0) {
+    *refLoc = 0;
+    return -1;
+  }
+
+  if (withDedup) {
+    *dedupLoc = createTable(tableBlocks(numClusters, sizeof(uint64_t)));
+    if (*dedupLoc < 0) {
+      *dedupLoc = 0;
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+//Sets up the tables of a mounted volume (a location of 0 = no such table)
+void refTableInit(int refLoc, int dedupLoc, int numClusters) {
+  tableClusters = numClusters;
+
+  refs.location = refLoc;
+  refs.numBlocks = tableBlocks(numClusters, sizeof(unsigned short));
+
+  hashes.location = dedupLoc;
+  hashes.numBlocks = tableBlocks(numClusters, sizeof(uint64_t));
+}
+
+//Returns 1 if the volume has a reference table, so clusters can be shared
+int refsEnabled() {
+  return refs.location != 0;
+}
+
+//Returns 1 if the cluster starting at block is used by more than one file
+int isShared(int block) {
+  if (!refs.location) {
+    return 0;
+  }
+
+  unsigned short* extraRefs = (unsigned short*)tableData(&refs);
+  return extraRefs[block / clusterBlocks] > 0;
+}
+
+//Adds a reference to the cluster starting at block (1 = done, 0 = the
+//volume has no reference table or the cluster has too many references)
+int addRef(int block) {
+  if (!refs.location) {
+    return 0;
+  }
+
+  int cluster = block / clusterBlocks;
+  unsigned short* extraRefs = (unsigned short*)tableData(&refs);
+  if (extraRefs[cluster] >= MAX_EXTRA_REFS) {
+    return 0;
+  }
+
+  extraRefs[cluster]++;
+  tableChanged(&refs, cluster, sizeof(unsigned short));
+  return 1;
+}
+
+//Drops an extra reference to cluster, returning 1 if the cluster is
+//still in use and 0 if it had no extra references and can be freed
+int dropRef(int cluster) {
+  if (!refs.location) {
+    return 0;
+  }
+
+  unsigned short* extraRefs = (unsigned short*)tableData(&refs);
+  if (extraRefs[cluster] == 0) {
+    return 0;
+  }
+
+  extraRefs[cluster]--;
+  tableChanged(&refs, cluster, sizeof(unsigned short));
+  return 1;
+}
+
+//Returns 1 if full data clusters are deduplicated on this volume
+int dedupEnabled() {
+  return hashes.location != 0;
+}
+
+//Hash of the contents of a full data cluster (never 0)
+uint64_t clusterHash(char* data) {
+  //64 bit FNV-1a
+  uint64_t hash = 14695981039346656037ULL;
+  for (int i = 0; i < clusterSize; i++) {
+    hash ^= (unsigned char)data[i];
+    hash *= 1099511628211ULL;
+  }
+
+  return hash ? hash : 1;
+}
+
+//Adds a cluster to the bucket of its hash in the in-memory index
+void indexAdd(int cluster, uint64_t hash) {
+  int bucket = hash & (numBuckets - 1);
+  hashNext[cluster] = hashBuckets[bucket];
+  hashBuckets[bucket] = cluster;
+}
+
+//Removes a cluster from the bucket of its hash in the in-memory index
+void indexRemove(int cluster, uint64_t hash) {
+  int* link = &hashBuckets[hash & (numBuckets - 1)];
+  while (*link != -1) {
+    if (*link == cluster) {
+      *link = hashNext[cluster];
+      return;
+    }
+    link = &hashNext[*link];
+  }
+}
+
+//Builds the in-memory index from the hashes stored on the disk
+void buildIndex() {
+  numBuckets = 1;
+  while (numBuckets < tableClusters) {
+    numBuckets *= 2;
+  }
+
+  hashBuckets = malloc(numBuckets * sizeof(int));
+  hashNext = malloc(tableClusters * sizeof(int));
+  if (!hashBuckets || !hashNext) {
+    mallocFailed();
+  }
+
+  for (int i = 0; i < numBuckets; i++) {
+    hashBuckets[i] = -1;
+  }
+
+  uint64_t* clusterHashes = (uint64_t*)tableData(&hashes);
+  for (int cluster = 0; cluster < tableClusters; cluster++) {
+    hashNext[cluster] = -1;
+    if (clusterHashes[cluster]) {
+      indexAdd(cluster, clusterHashes[cluster]);
+    }
+  }
+}
+
+//Returns the first block of a cluster already on the volume holding the
+//same data as data, or 0 if there is none
+int findDuplicate(char* data, uint64_t hash) {
+  if (!dedupEnabled()) {
+    return 0;
+  }
+  if (!hashBuckets) {
+    buildIndex();
+  }
+
+  uint64_t* clusterHashes = (uint64_t*)tableData(&hashes);
+  unsigned short* extraRefs = (unsigned short*)tableData(&refs);
+  char* candidate = NULL;
+  int found = 0;
+
+  for (int cluster = hashBuckets[hash & (numBuckets - 1)]; cluster != -1 &&
+    !found; cluster = hashNext[cluster]) {
+    if (clusterHashes[cluster] != hash ||
+      extraRefs[cluster] >= MAX_EXTRA_REFS) {
+      continue;
+    }
+
+    //The data is compared as well in case two clusters have the same hash
+    if (!candidate) {
+      candidate = malloc(clusterSize);
+      if (!candidate) {
+        mallocFailed();
+      }
+    }
+    segmentRead(candidate, clusterBlocks, cluster * clusterBlocks);
+    if (memcmp(candidate, data, clusterSize) == 0) {
+      found = cluster * clusterBlocks;
+    }
+  }
+
+  free(candidate);
+  candidate = NULL;
+
+  return found;
+}
+
+//Records the hash of the data in the cluster starting at block (0 = the
+//cluster does not hold a full cluster of data that can be shared)
+void setClusterHash(int block, uint64_t hash) {
+  if (!dedupEnabled()) {
+    return;
+  }
+
+  int cluster = block / clusterBlocks;
+  uint64_t* clusterHashes = (uint64_t*)tableData(&hashes);
+  uint64_t oldHash = clusterHashes[cluster];
+  if (oldHash == hash) {
+    return;
+  }
+
+  if (hashBuckets) {
+    if (oldHash) {
+      indexRemove(cluster, oldHash);
+    }
+    if (hash) {
+      indexAdd(cluster, hash);
+    }
+  }
+
+  clusterHashes[cluster] = hash;
+  tableChanged(&hashes, cluster, sizeof(uint64_t));
+}
+
+//Writes the parts of the tables that changed out to the disk
+void writeRefTable() {
+  writeTable(&refs);
+  writeTable(&hashes);
+}
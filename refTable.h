@@ -0,0 +1,92 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: refTable.h
+*
+* Description: This file holds the prototypes of the functions that
+* keep track of clusters shared by more than one file. The reference
+* table holds how many extra references each cluster has, so that a
+* shared cluster is only freed when its last reference is dropped.
+* The dedup table holds the content hash of each full data cluster
+* so that identical data can be stored once.
+*
+**************************************************************/
+#ifndef REFTABLE_H
+#define REFTABLE_H
+
+#include <stdint.h>
+#include "fs_commands.h"
+
+//Most extra references a cluster can have
+#define MAX_EXTRA_REFS 65535
+
+//A table with an entry for every cluster that is kept on the disk. It is
+//read the first time it is needed and changes to it are kept in memory
+//until writeTable() writes the blocks that changed back out
+typedef struct diskTable {
+  char* data;         //Copy of the table in memory
+  int location;       //First block of the table on disk (0 = no table)
+  int numBlocks;      //Number of blocks the table takes up
+  int firstChanged;   //First block of the table that changed (-1 = none)
+  int lastChanged;    //Last block of the table that changed
+} diskTable;
+
+//Number of blocks a table with entrySize bytes per cluster takes up
+int tableBlocks(int numClusters, int entrySize);
+
+//Returns the in-memory copy of a table
+char* tableData(diskTable* table);
+
+//Records which blocks of a table hold the entry of a cluster
+void tableChanged(diskTable* table, int cluster, int entrySize);
+
+//Writes the blocks of a table that changed out to the disk
+void writeTable(diskTable* table);
+
+//Allocates and zeroes a table of numBlocks blocks, returning where it starts
+int createTable(int numBlocks);
+
+//Creates the tables of a new volume with numClusters clusters and stores
+//where they start in refLoc and dedupLoc (dedupLoc is 0 unless withDedup)
+int refTableCreate(int numClusters, int withDedup, int* refLoc, int* dedupLoc);
+
+//Sets up the tables of a mounted volume (a location of 0 = no such table)
+void refTableInit(int refLoc, int dedupLoc, int numClusters);
+
+//Returns 1 if the volume has a reference table, so clusters can be shared
+int refsEnabled();
+
+//Returns 1 if the cluster starting at block is used by more than one file
+int isShared(int block);
+
+//Adds a reference to the cluster starting at block (1 = done, 0 = the
+//volume has no reference table or the cluster has too many references)
+int addRef(int block);
+
+//Drops an extra reference to cluster, returning 1 if the cluster is
+//still in use and 0 if it had no extra references and can be freed
+int dropRef(int cluster);
+
+//Returns 1 if full data clusters are deduplicated on this volume
+int dedupEnabled();
+
+//Hash of the contents of a full data cluster (never 0)
+uint64_t clusterHash(char* data);
+
+//Returns the first block of a cluster already on the volume holding the
+//same data as data, or 0 if there is none
+int findDuplicate(char* data, uint64_t hash);
+
+//Records the hash of the data in the cluster starting at block (0 = the
+//cluster does not hold a full cluster of data that can be shared)
+void setClusterHash(int block, uint64_t hash);
+
+//Writes the parts of the tables that changed out to the disk
+void writeRefTable();
+
+#endif
@@ -0,0 +1,214 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: relocate.c
+*
+* Description: This file holds the functions that move data clusters
+* of files to new places on the volume. A moved file gets a new block
+* map before its directory entry is changed, and its old clusters are
+* only freed after that, so the file holds either all old or all new
+* data if a move is stopped partway.
+*
+**************************************************************/
+
+#include "relocate.h"
+#include "blockMap.h"
+#include "b_io.h"
+#include "refTable.h"
+#include "snapshot.h"
+
+//Adds a file whose clusters can be moved to the owner map
+int addOwnedFile(ownerMap* owners, int dirLocation, dirEntry* entry) {
+  if (owners->numFiles == owners->filesCapacity) {
+    owners->filesCapacity = owners->filesCapacity ?
+      owners->filesCapacity * 2 : 16;
+    owners->files = realloc(owners->files,
+      owners->filesCapacity * sizeof(ownedFile));
+    if (!owners->files) {
+      mallocFailed();
+    }
+  }
+
+  ownedFile* file = &owners->files[owners->numFiles];
+  file->dirLocation = dirLocation;
+  strcpy(file->name, entry->filename);
+  file->fileSize = entry->fileSize;
+  return owners->numFiles++;
+}
+
+//Records the owner of each data cluster of the files in the directory at
+//location and the directories under it, leaving out the snapshots
+void findOwners(ownerMap* owners, int location, int snapshots) {
+  hashTable* dir = readTableData(location);
+
+  for (int i = 0; i < SIZE; i++) {
+    for (node* n = dir->entries[i]; n != NULL; n = n->next) {
+      dirEntry* entry = n->value;
+      if (strcmp(entry->filename, "") == 0 ||
+        strcmp(entry->filename, ".") == 0 ||
+        strcmp(entry->filename, "..") == 0) {
+        continue;
+      }
+
+      if (entry->isDir) {
+        if (entry->location != snapshots) {
+          findOwners(owners, entry->location, snapshots);
+        }
+        continue;
+      }
+      if (entry->compressed || !entry->location ||
+        fileIsOpen(location, entry->filename)) {
+        continue;
+      }
+
+      int file = addOwnedFile(owners, location, entry);
+      blockMap* map = mapLoadEntry(entry);
+      for (int lb = 0; lb < map->numBlocks; lb++) {
+        int block = map->blocks[lb];
+        if (block && !isShared(block)) {
+          owners->owner[block / clusterBlocks] = file;
+          owners->ownerLb[block / clusterBlocks] = lb;
+        }
+      }
+      mapFree(map);
+      map = NULL;
+    }
+  }
+
+  clean(dir);
+  dir = NULL;
+}
+
+//Records which file owns each data cluster on the volume. Clusters of
+//files that are open, compressed, or shared are left without an owner,
+//so they are never moved, and so are the files in the snapshots.
+ownerMap* ownerMapBuild() {
+  int numClusters = numOfInts * 32;
+  ownerMap* owners = calloc(1, sizeof(ownerMap));
+  if (!owners) {
+    mallocFailed();
+  }
+  owners->owner = malloc(numClusters * sizeof(int));
+  owners->ownerLb = malloc(numClusters * sizeof(int));
+  if (!owners->owner || !owners->ownerLb) {
+    mallocFailed();
+  }
+  for (int c = 0; c < numClusters; c++) {
+    owners->owner[c] = -1;
+  }
+
+  hashTable* root = getDir("/");
+  int rootLocation = root->location;
+  clean(root);
+  root = NULL;
+
+  //Every file in a snapshot shares its clusters, so none can be moved
+  findOwners(owners, rootLocation, snapshotsLocation());
+
+  return owners;
+}
+
+//Frees the memory used by the owner map
+void ownerMapFree(ownerMap* owners) {
+  free(owners->files);
+  owners->files = NULL;
+  free(owners->owner);
+  owners->owner = NULL;
+  free(owners->ownerLb);
+  owners->ownerLb = NULL;
+  free(owners);
+}
+
+//Moves the clusters in clusters from start onwards that belong to the
+//owner of clusters[start], returning the number moved. The entries of
+//newBlocks it has dealt with are set to 0.
+int relocateFile(ownerMap* owners, int* clusters, int* newBlocks,
+  int count, int start, char* data) {
+  int fileIndex = owners->owner[clusters[start]];
+  ownedFile* file = &owners->files[fileIndex];
+  hashTable* dir = readTableData(file->dirLocation);
+  dirEntry* entry = getEntry(file->name, dir);
+  blockMap* map = mapLoadEntry(entry);
+
+  int* freed = malloc(count * sizeof(int));
+  if (!freed) {
+    mallocFailed();
+  }
+
+  int moved = 0;
+  for (int i = start; i < count; i++) {
+    freed[i] = 0;
+    if (owners->owner[clusters[i]] != fileIndex) {
+      continue;
+    }
+    owners->owner[clusters[i]] = -1;
+
+    //The copy is dropped instead if the file no longer uses the cluster
+    int lb = owners->ownerLb[clusters[i]];
+    int oldBlock = clusters[i] * clusterBlocks;
+    if (mapGet(map, lb) != oldBlock) {
+      freed[i] = newBlocks[i];
+      newBlocks[i] = 0;
+      continue;
+    }
+    mapSet(map, lb, newBlocks[i]);
+    freed[i] = oldBlock;
+
+    //Only full clusters are hashed for dedup
+    if (dedupEnabled() && (off_t)(lb + 1) * clusterSize <= file->fileSize) {
+      setClusterHash(newBlocks[i],
+        clusterHash(data + (size_t)i * clusterSize));
+    }
+    newBlocks[i] = 0;
+    moved++;
+  }
+
+  //The new map is on the disk before the directory entry points at it,
+  //and the old clusters are only freed after that
+  entry->location = mapSave(map);
+  entry->tailMap = mapTail(map);
+  writeFreeSpace();
+  writeTableData(dir, file->dirLocation);
+  dir = NULL;
+
+  for (int i = start; i < count; i++) {
+    if (freed[i]) {
+      setBlocksAsFree(freed[i], clusterBlocks);
+    }
+  }
+
+  free(freed);
+  freed = NULL;
+  mapFree(map);
+  map = NULL;
+
+  return moved;
+}
+
+//Points the files that own the count clusters in clusters at the copies
+//of them at newBlocks, then frees the old clusters. The copies must
+//already be on the disk, and data holds what they hold, in the same
+//order. It returns the number of clusters moved, and the copies of the
+//ones that were not moved are freed. Every entry of newBlocks is set
+//to 0.
+int relocateClusters(ownerMap* owners, int* clusters, int* newBlocks,
+  int count, char* data) {
+  int moved = 0;
+
+  for (int i = 0; i < count; i++) {
+    if (owners->owner[clusters[i]] >= 0) {
+      moved += relocateFile(owners, clusters, newBlocks, count, i, data);
+    } else if (newBlocks[i]) {
+      setBlocksAsFree(newBlocks[i], clusterBlocks);
+      newBlocks[i] = 0;
+    }
+  }
+
+  writeFreeSpace();
+  return moved;
+}
@@ -0,0 +1,55 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: relocate.h
+*
+* Description: This file holds the prototypes of the functions that
+* move data clusters of files to new places on the volume, as used by
+* the segment cleaner and the tier mover. The owner map records which
+* file and logical block each data cluster holds, so that the block
+* map of its file can be pointed at the cluster's new place.
+*
+**************************************************************/
+#ifndef RELOCATE_H
+#define RELOCATE_H
+
+#include "fs_commands.h"
+
+//A file whose data clusters can be moved
+typedef struct ownedFile {
+  int dirLocation;        //Directory the file is in
+  char name[20];
+  off_t fileSize;
+} ownedFile;
+
+typedef struct ownerMap {
+  int* owner;             //File each cluster holds data of (-1 = none)
+  int* ownerLb;           //Logical block of the file the cluster holds
+  ownedFile* files;
+  int numFiles;
+  int filesCapacity;
+} ownerMap;
+
+//Records which file owns each data cluster on the volume. Clusters of
+//files that are open, compressed, or shared are left without an owner,
+//so they are never moved, and so are the files in the snapshots.
+ownerMap* ownerMapBuild();
+
+//Frees the memory used by the owner map
+void ownerMapFree(ownerMap* owners);
+
+//Points the files that own the count clusters in clusters at the copies
+//of them at newBlocks, then frees the old clusters. The copies must
+//already be on the disk, and data holds what they hold, in the same
+//order. It returns the number of clusters moved, and the copies of the
+//ones that were not moved are freed. Every entry of newBlocks is set
+//to 0.
+int relocateClusters(ownerMap* owners, int* clusters, int* newBlocks,
+  int count, char* data);
+
+#endif
@@ -0,0 +1,297 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: scrub.c
+*
+* Description: This file holds the scrubber. It first walks the
+* directory tree to list the clusters of every file, sorts them by
+* their place on the volume, and then has several threads read them
+* in that order a large run at a time. Reads from the volume are done
+* one at a time, since LBAread is not thread safe, while the checksums
+* of one run are computed as the next run is read.
+*
+**************************************************************/
+
+#include <pthread.h>
+#include "scrub.h"
+#include "blockMap.h"
+#include "b_io.h"
+#include "checksum.h"
+#include "segment.h"
+
+#define SCRUB_READ_SIZE (4 * 1024 * 1024)  //Most bytes read at once
+
+//A run of clusters on the volume that holds data of a file
+typedef struct scrubExtent {
+  int block;          //First block of the run
+  int numClusters;    //Number of clusters in the run
+  int file;           //Index of the file in the scrub's paths
+} scrubExtent;
+
+typedef struct scrubState {
+  scrubExtent* extents;   //Every run of every file, sorted by block
+  int numExtents;
+  int extentsCapacity;
+  char** paths;           //Path of each file
+  char* corrupt;          //1 for each file that has corrupt data
+  int numFiles;
+  int filesCapacity;
+  int next;               //Next extent to be checked
+  long clustersChecked;
+  pthread_mutex_t lock;   //Guards next, corrupt and clustersChecked
+  pthread_mutex_t ioLock; //Lets one thread at a time read the volume
+} scrubState;
+
+//Adds a run of clusters of the last file added to the scrub
+void addExtent(scrubState* state, int block, int numClusters) {
+  if (state->numExtents == state->extentsCapacity) {
+    state->extentsCapacity = state->extentsCapacity ?
+      state->extentsCapacity * 2 : 64;
+    state->extents = realloc(state->extents,
+      state->extentsCapacity * sizeof(scrubExtent));
+    if (!state->extents) {
+      mallocFailed();
+    }
+  }
+
+  scrubExtent* extent = &state->extents[state->numExtents++];
+  extent->block = block;
+  extent->numClusters = numClusters;
+  extent->file = state->numFiles - 1;
+}
+
+//Adds a file and the runs of clusters that hold its data to the scrub
+void addFile(scrubState* state, dirEntry* entry, char* path) {
+  if (state->numFiles == state->filesCapacity) {
+    state->filesCapacity = state->filesCapacity ?
+      state->filesCapacity * 2 : 16;
+    state->paths = realloc(state->paths, state->filesCapacity * sizeof(char*));
+    if (!state->paths) {
+      mallocFailed();
+    }
+  }
+  state->paths[state->numFiles++] = path;
+
+  //A run of the file's clusters is cut short so that it is never longer
+  //than one read
+  int maxClusters = SCRUB_READ_SIZE / clusterSize;
+  if (maxClusters < 1) {
+    maxClusters = 1;
+  }
+
+  blockMap* map = mapLoadEntry(entry);
+  if (map->chunked) {
+    for (int i = 0; i + 1 < map->numBlocks; i += 2) {
+      if (map->blocks[i]) {
+        addExtent(state, map->blocks[i], chunkClusters(map->blocks[i + 1]));
+      }
+    }
+  } else {
+    int i = 0;
+    while (i < map->numBlocks) {
+      int start = map->blocks[i];
+      int run = 1;
+      while (i + run < map->numBlocks && start && run < maxClusters &&
+        map->blocks[i + run] == start + run * clusterBlocks) {
+        run++;
+      }
+      if (start) {
+        addExtent(state, start, run);
+      }
+      i += run;
+    }
+  }
+
+  mapFree(map);
+  map = NULL;
+}
+
+//Adds every file in the directory at location, whose path is path, and
+//the directories under it to the scrub
+void addDir(scrubState* state, int location, char* path) {
+  hashTable* dir = readTableData(location);
+
+  for (int i = 0; i < SIZE; i++) {
+    for (node* n = dir->entries[i]; n != NULL; n = n->next) {
+      dirEntry* entry = n->value;
+      if (strcmp(entry->filename, "") == 0 ||
+        strcmp(entry->filename, ".") == 0 ||
+        strcmp(entry->filename, "..") == 0) {
+        continue;
+      }
+
+      char* childPath = malloc(strlen(path) + strlen(entry->filename) + 2);
+      if (!childPath) {
+        mallocFailed();
+      }
+      sprintf(childPath, "%s%s", path, entry->filename);
+
+      if (entry->isDir) {
+        strcat(childPath, "/");
+        addDir(state, entry->location, childPath);
+        free(childPath);
+        childPath = NULL;
+      } else {
+        addFile(state, entry, childPath);
+      }
+    }
+  }
+
+  clean(dir);
+  dir = NULL;
+}
+
+//Orders runs of clusters by where they are on the volume
+int compareExtents(const void* a, const void* b) {
+  const scrubExtent* first = a;
+  const scrubExtent* second = b;
+  return (first->block > second->block) - (first->block < second->block);
+}
+
+//Checks runs of clusters until there are none left
+void* scrubWorker(void* arg) {
+  scrubState* state = arg;
+
+  int maxBlocks = (SCRUB_READ_SIZE / clusterSize) * clusterBlocks;
+  if (maxBlocks < clusterBlocks) {
+    maxBlocks = clusterBlocks;
+  }
+  char* data = malloc((size_t)maxBlocks * blockSize);
+  if (!data) {
+    mallocFailed();
+  }
+
+  while (1) {
+    //Take the next runs that sit together on the volume, up to one read,
+    //so the volume is read from start to end. Runs shared by more than
+    //one file are read once and checked for each of them.
+    pthread_mutex_lock(&state->lock);
+    int first = state->next;
+    if (first >= state->numExtents) {
+      pthread_mutex_unlock(&state->lock);
+      break;
+    }
+
+    int start = state->extents[first].block;
+    int end = start + state->extents[first].numClusters * clusterBlocks;
+    int last = first + 1;
+    while (last < state->numExtents && state->extents[last].block <= end) {
+      scrubExtent* extent = &state->extents[last];
+      int extentEnd = extent->block + extent->numClusters * clusterBlocks;
+      if (extentEnd > end) {
+        if (extentEnd - start > maxBlocks) {
+          break;
+        }
+        end = extentEnd;
+      }
+      last++;
+    }
+    state->next = last;
+    pthread_mutex_unlock(&state->lock);
+
+    pthread_mutex_lock(&state->ioLock);
+    deviceRead(data, end - start, start);
+    pthread_mutex_unlock(&state->ioLock);
+
+    for (int i = first; i < last; i++) {
+      scrubExtent* extent = &state->extents[i];
+      char* extentData = data + (size_t)(extent->block - start) * blockSize;
+      if (!checksumsMatch(extentData, extent->block, extent->numClusters)) {
+        pthread_mutex_lock(&state->lock);
+        state->corrupt[extent->file] = 1;
+        pthread_mutex_unlock(&state->lock);
+      }
+    }
+
+    pthread_mutex_lock(&state->lock);
+    state->clustersChecked += (end - start) / clusterBlocks;
+    pthread_mutex_unlock(&state->lock);
+  }
+
+  free(data);
+  data = NULL;
+
+  return NULL;
+}
+
+//Checks every data cluster of every file against its checksum using
+//numThreads threads, printing the path of each file with corrupt data.
+//It returns the number of corrupt files or -1 if the volume has no
+//checksums.
+int fs_scrub(int numThreads) {
+  if (!checksumsEnabled()) {
+    printf("Error: this volume does not keep checksums of its data\n");
+    return -1;
+  }
+
+  if (numThreads < 1) {
+    numThreads = 1;
+  } else if (numThreads > SCRUB_MAX_THREADS) {
+    numThreads = SCRUB_MAX_THREADS;
+  }
+
+  //Data still in the buffers of open files or waiting in the log is
+  //written out so that what is on the volume matches the checksums, and
+  //nothing changes the volume while it is checked
+  lockVolume(1);
+  b_sync();
+  segmentFlush();
+
+  scrubState state;
+  memset(&state, 0, sizeof(state));
+  pthread_mutex_init(&state.lock, NULL);
+  pthread_mutex_init(&state.ioLock, NULL);
+
+  hashTable* root = getDir("/");
+  int rootLocation = root->location;
+  clean(root);
+  root = NULL;
+  addDir(&state, rootLocation, "/");
+
+  qsort(state.extents, state.numExtents, sizeof(scrubExtent), compareExtents);
+
+  state.corrupt = calloc(state.numFiles + 1, 1);
+  if (!state.corrupt) {
+    mallocFailed();
+  }
+
+  //The table is read in before the threads start using it
+  loadChecksumTable();
+
+  pthread_t threads[SCRUB_MAX_THREADS];
+  for (int i = 0; i < numThreads; i++) {
+    pthread_create(&threads[i], NULL, scrubWorker, &state);
+  }
+  for (int i = 0; i < numThreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  int numCorrupt = 0;
+  for (int i = 0; i < state.numFiles; i++) {
+    if (state.corrupt[i]) {
+      printf("corrupt: %s\n", state.paths[i]);
+      numCorrupt++;
+    }
+    free(state.paths[i]);
+    state.paths[i] = NULL;
+  }
+  printf("Scrubbed %ld clusters of %d files, %d corrupt\n",
+    state.clustersChecked, state.numFiles, numCorrupt);
+
+  free(state.paths);
+  state.paths = NULL;
+  free(state.extents);
+  state.extents = NULL;
+  free(state.corrupt);
+  state.corrupt = NULL;
+  pthread_mutex_destroy(&state.lock);
+  pthread_mutex_destroy(&state.ioLock);
+  unlockVolume();
+
+  return numCorrupt;
+}
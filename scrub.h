@@ -0,0 +1,29 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: scrub.h
+*
+* Description: This file holds the prototype of the scrubber, which
+* checks the data of every file on the volume against its checksums.
+*
+**************************************************************/
+#ifndef SCRUB_H
+#define SCRUB_H
+
+#include "fs_commands.h"
+
+//Most threads the scrubber checks data with
+#define SCRUB_MAX_THREADS 64
+
+//Checks every data cluster of every file against its checksum using
+//numThreads threads, printing the path of each file with corrupt data.
+//It returns the number of corrupt files or -1 if the volume has no
+//checksums.
+int fs_scrub(int numThreads);
+
+#endif
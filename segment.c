@@ -0,0 +1,362 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: segment.c
+*
+* Description: This file holds the log of a log-structured volume and
+* its segment cleaner.
+*
+* A segment is a run of free clusters. Its clusters are allocated one
+* at a time as data is appended, so the rest of the run stays free
+* space until it is used. If something else takes the next cluster of
+* the run first, the segment is written out and a new one is started.
+* Data waiting in the open segment is read from memory, so it is only
+* written out when the segment is full, a file is flushed, the volume
+* is unmounted, or a tool that reads the disk directly needs it there.
+*
+**************************************************************/
+
+#include "segment.h"
+#include "b_io.h"
+#include "checksum.h"
+#include "relocate.h"
+
+//The open segment (segStart = 0 when there is none)
+int segStart = 0;       //First block of the segment's run
+int segClusters = 0;    //Number of clusters in the run
+int segUsed = 0;        //Number of clusters appended so far
+int segWritten = 0;     //Number of clusters already written out
+char* segBuf = NULL;    //Data of the clusters appended to the segment
+char* segLive = NULL;   //1 for each appended cluster still to be written
+int segCleaning = 0;    //1 while the cleaner is moving data into the log
+
+//A segment sized part of the volume the cleaner could free
+typedef struct cleanWindow {
+  int first;              //First cluster of the part
+  int live;               //Number of its clusters in use
+} cleanWindow;
+
+//Returns 1 if the volume writes changed file data to the log
+int segmentsEnabled() {
+  return logStructured;
+}
+
+//Writes out the open segment and lets go of it
+void segmentClose() {
+  segmentFlush();
+
+  free(segBuf);
+  segBuf = NULL;
+  free(segLive);
+  segLive = NULL;
+  segStart = 0;
+  segClusters = 0;
+  segUsed = 0;
+  segWritten = 0;
+}
+
+//Starts a new segment at the longest run of free clusters up to a
+//segment long. When the free space is too broken up for that, the
+//cleaner is run first to free up a whole segment.
+int segmentOpen() {
+  int wantClusters = SEGMENT_SIZE / clusterSize;
+  if (wantClusters < 1) {
+    wantClusters = 1;
+  }
+
+  int runBlocks;
+  int freeBlock = getFreeRun(wantClusters * clusterBlocks, &runBlocks);
+  if (freeBlock >= 0 && runBlocks < wantClusters * clusterBlocks / 2 &&
+    !segCleaning && segmentClean(1) > 0) {
+    freeBlock = getFreeRun(wantClusters * clusterBlocks, &runBlocks);
+  }
+  // Check if the freeBlock returned is valid or not
+  if (freeBlock < 0) {
+    return -1;
+  }
+
+  segStart = freeBlock;
+  segClusters = runBlocks / clusterBlocks;
+  segBuf = malloc((size_t)segClusters * clusterSize);
+  segLive = calloc(segClusters, 1);
+  if (!segBuf || !segLive) {
+    mallocFailed();
+  }
+
+  return 0;
+}
+
+//Appends a cluster of data to the open segment, opening a new segment if
+//needed, and returns the block it will be written to (-1 = volume full)
+int segmentAppend(char* data) {
+  if (segStart && !clusterIsFree(segStart / clusterBlocks + segUsed)) {
+    segmentClose();
+  }
+  if (!segStart && segmentOpen() < 0) {
+    return -1;
+  }
+
+  int block = segStart + segUsed * clusterBlocks;
+  setBlocksAsAllocated(block, clusterBlocks);
+  memcpy(segBuf + (size_t)segUsed * clusterSize, data, clusterSize);
+  segLive[segUsed] = 1;
+  segUsed++;
+
+  //A full segment is written out right away
+  if (segUsed == segClusters) {
+    segmentClose();
+  }
+
+  return block;
+}
+
+//Drops the copy of the clusters in numBlocks blocks starting at block
+//that the open segment holds, since they were freed or written over
+void segmentDiscard(int block, int numBlocks) {
+  if (!segStart || block + numBlocks <= segStart) {
+    return;
+  }
+
+  int first = block < segStart ? 0 : (block - segStart) / clusterBlocks;
+  int last = (block + numBlocks - 1 - segStart) / clusterBlocks;
+  for (int slot = first < segWritten ? segWritten : first;
+    slot <= last && slot < segUsed; slot++) {
+    segLive[slot] = 0;
+  }
+}
+
+//Reads numBlocks blocks of file data starting at block, taking the
+//clusters that are still waiting in the open segment from memory
+void segmentRead(char* buffer, int numBlocks, int block) {
+  deviceRead(buffer, numBlocks, block);
+
+  if (!segStart || block + numBlocks <= segStart ||
+    block >= segStart + segUsed * clusterBlocks) {
+    return;
+  }
+
+  for (int slot = segWritten; slot < segUsed; slot++) {
+    int slotBlock = segStart + slot * clusterBlocks;
+    if (!segLive[slot] || slotBlock + clusterBlocks <= block ||
+      slotBlock >= block + numBlocks) {
+      continue;
+    }
+
+    //Only the part of the cluster that was asked for is copied
+    int from = slotBlock > block ? slotBlock : block;
+    int to = slotBlock + clusterBlocks < block + numBlocks ?
+      slotBlock + clusterBlocks : block + numBlocks;
+    memcpy(buffer + (size_t)(from - block) * blockSize,
+      segBuf + (size_t)slot * clusterSize + (size_t)(from - slotBlock) * blockSize,
+      (size_t)(to - from) * blockSize);
+  }
+}
+
+//Writes the data appended to the open segment out to the disk
+void segmentFlush() {
+  if (!segStart) {
+    return;
+  }
+
+  //The clusters still to be written are usually all live, so they go
+  //out with a single LBAwrite. Clusters dropped since they were appended
+  //are skipped, since they may already be in use by something else.
+  int slot = segWritten;
+  while (slot < segUsed) {
+    if (!segLive[slot]) {
+      slot++;
+      continue;
+    }
+
+    int run = 1;
+    while (slot + run < segUsed && segLive[slot + run]) {
+      run++;
+    }
+    deviceWrite(segBuf + (size_t)slot * clusterSize, run * clusterBlocks,
+      segStart + slot * clusterBlocks);
+    slot += run;
+  }
+  segWritten = segUsed;
+}
+
+//Orders parts of the volume from the fewest clusters in use to the most
+int compareWindows(const void* a, const void* b) {
+  return ((cleanWindow*)a)->live - ((cleanWindow*)b)->live;
+}
+
+//Moves the data in the part of the volume starting at cluster first into
+//the log, returning the number of clusters moved or -1 if the log ran
+//out of space
+int cleanWindowData(ownerMap* owners, int first, int numClusters) {
+  char* data = malloc((size_t)numClusters * clusterSize);
+  int* clusters = malloc(numClusters * sizeof(int));
+  int* newBlocks = calloc(numClusters, sizeof(int));
+  if (!data || !clusters || !newBlocks) {
+    mallocFailed();
+  }
+
+  segmentRead(data, numClusters * clusterBlocks, first * clusterBlocks);
+
+  //The data of the clusters being moved is packed to the front of the
+  //buffer, in the same order as the clusters
+  int count = 0;
+  int full = 0;
+  for (int s = 0; s < numClusters; s++) {
+    if (owners->owner[first + s] < 0) {
+      continue;
+    }
+
+    char* clusterData = data + (size_t)count * clusterSize;
+    memmove(clusterData, data + (size_t)s * clusterSize, clusterSize);
+    clusters[count] = first + s;
+    newBlocks[count] = segmentAppend(clusterData);
+    if (newBlocks[count] < 0) {
+      newBlocks[count] = 0;
+      full = 1;
+      break;
+    }
+    copyChecksums((first + s) * clusterBlocks, newBlocks[count], 1);
+    count++;
+  }
+
+  //The moved data is on the disk before any map points at it
+  segmentFlush();
+
+  int moved = -1;
+  if (!full) {
+    moved = relocateClusters(owners, clusters, newBlocks, count, data);
+  } else {
+    for (int i = 0; i < count; i++) {
+      setBlocksAsFree(newBlocks[i], clusterBlocks);
+    }
+  }
+
+  free(data);
+  data = NULL;
+  free(clusters);
+  clusters = NULL;
+  free(newBlocks);
+  newBlocks = NULL;
+
+  return moved;
+}
+
+//Moves the data left in up to maxSegments of the emptiest segment sized
+//parts of the volume into the log, so that each becomes free space a new
+//segment can use, returning the number of parts freed
+int segmentClean(int maxSegments) {
+  int windowClusters = SEGMENT_SIZE / clusterSize;
+  if (windowClusters < 2) {
+    return 0;     //every free cluster is already a whole segment
+  }
+
+  //The data left in each part is moved into the log, so nothing can read
+  //it meanwhile
+  lockVolume(1);
+  segCleaning = 1;
+  segmentClose();
+
+  int numClusters = numOfInts * 32;
+  ownerMap* owners = ownerMapBuild();
+
+  //A part is worth cleaning if at most half of it is in use and every
+  //cluster in use holds data the cleaner can move
+  int numWindows = numClusters / windowClusters;
+  cleanWindow* windows = malloc((numWindows + 1) * sizeof(cleanWindow));
+  if (!windows) {
+    mallocFailed();
+  }
+  int numCandidates = 0;
+  for (int w = 0; w < numWindows; w++) {
+    int first = w * windowClusters;
+    int live = 0;
+    int movable = 1;
+    for (int c = first; c < first + windowClusters && movable; c++) {
+      if (!clusterIsFree(c)) {
+        live++;
+        movable = owners->owner[c] >= 0;
+      }
+    }
+
+    if (movable && live > 0 && live <= windowClusters / 2) {
+      windows[numCandidates].first = first;
+      windows[numCandidates].live = live;
+      numCandidates++;
+    }
+  }
+  qsort(windows, numCandidates, sizeof(cleanWindow), compareWindows);
+  if (numCandidates > maxSegments) {
+    numCandidates = maxSegments;
+  }
+
+  //The free clusters of the parts being cleaned are held while the data
+  //is moved, so that the log does not move it right back into them
+  char* held = calloc((size_t)numCandidates * windowClusters, 1);
+  if (!held) {
+    mallocFailed();
+  }
+  for (int w = 0; w < numCandidates; w++) {
+    for (int c = 0; c < windowClusters; c++) {
+      if (clusterIsFree(windows[w].first + c)) {
+        setBlocksAsAllocated((windows[w].first + c) * clusterBlocks,
+          clusterBlocks);
+        held[w * windowClusters + c] = 1;
+      }
+    }
+  }
+
+  int cleaned = 0;
+  int clustersMoved = 0;
+  for (int w = 0; w < numCandidates; w++) {
+    int moved = cleanWindowData(owners, windows[w].first, windowClusters);
+    if (moved < 0) {
+      break;
+    }
+    clustersMoved += moved;
+    cleaned++;
+  }
+
+  for (int w = 0; w < numCandidates; w++) {
+    for (int c = 0; c < windowClusters; c++) {
+      if (held[w * windowClusters + c]) {
+        setBlocksAsFree((windows[w].first + c) * clusterBlocks,
+          clusterBlocks);
+      }
+    }
+  }
+
+  segmentClose();
+  writeFreeSpace();
+  segCleaning = 0;
+  unlockVolume();
+
+  if (cleaned > 0) {
+    printf("Cleaned %d segments, moved %d clusters\n", cleaned,
+      clustersMoved);
+  }
+
+  free(held);
+  held = NULL;
+  free(windows);
+  windows = NULL;
+  ownerMapFree(owners);
+  owners = NULL;
+
+  return cleaned;
+}
+
+//Runs the segment cleaner on a log-structured volume, returning the
+//number of segments freed or -1 if the volume is not log structured
+int fs_clean(int maxSegments) {
+  if (!segmentsEnabled()) {
+    printf("Error: the volume is not log structured\n");
+    return -1;
+  }
+
+  return segmentClean(maxSegments);
+}
@@ -0,0 +1,57 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: segment.h
+*
+* Description: This file holds the prototypes of the functions used
+* by a log-structured volume. On such a volume a changed cluster of
+* file data is never written back where it was. It is appended to the
+* open segment, a run of free clusters that is filled in memory and
+* written out with a single LBAwrite, and the file's block map is
+* pointed at its new place. The segment cleaner frees up whole
+* segments of space by moving the little data left in mostly empty
+* parts of the volume into the log.
+*
+**************************************************************/
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#include "fs_commands.h"
+
+//Number of bytes of data gathered before a segment is written out. A
+//volume with larger clusters uses a cluster a segment.
+#define SEGMENT_SIZE (1024 * 1024)
+
+//Returns 1 if the volume writes changed file data to the log
+int segmentsEnabled();
+
+//Appends a cluster of data to the open segment, opening a new segment if
+//needed, and returns the block it will be written to (-1 = volume full)
+int segmentAppend(char* data);
+
+//Drops the copy of the clusters in numBlocks blocks starting at block
+//that the open segment holds, since they were freed or written over
+void segmentDiscard(int block, int numBlocks);
+
+//Reads numBlocks blocks of file data starting at block, taking the
+//clusters that are still waiting in the open segment from memory
+void segmentRead(char* buffer, int numBlocks, int block);
+
+//Writes the data appended to the open segment out to the disk
+void segmentFlush();
+
+//Moves the data left in up to maxSegments of the emptiest segment sized
+//parts of the volume into the log, so that each becomes free space a new
+//segment can use, returning the number of parts freed
+int segmentClean(int maxSegments);
+
+//Runs the segment cleaner on a log-structured volume, returning the
+//number of segments freed or -1 if the volume is not log structured
+int fs_clean(int maxSegments);
+
+#endif
@@ -0,0 +1,253 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: snapshot.c
+*
+* Description: This file holds the functions that take, protect, and
+* remove read-only snapshots of the volume.
+*
+**************************************************************/
+
+#include "snapshot.h"
+#include "blockMap.h"
+#include "b_io.h"
+#include "refTable.h"
+
+//Returns the location of the directory that holds the snapshots (0 if
+//no snapshot has been taken)
+int snapshotsLocation() {
+  hashTable* root = getDir("/");
+  dirEntry* entry = getEntry(SNAPSHOT_DIR, root);
+  int location = entry && entry->isDir ? entry->location : 0;
+  clean(root);
+  root = NULL;
+
+  return location;
+}
+
+//Returns 1 if the directory at location is ancestor or is inside it
+int isWithin(int location, int ancestor) {
+  //Follow the ".." entries up to root, whose ".." is itself
+  while (location != ancestor) {
+    hashTable* dir = readTableData(location);
+    int parent = getEntry("..", dir)->location;
+    clean(dir);
+    dir = NULL;
+
+    if (parent == location) {
+      return 0;
+    }
+    location = parent;
+  }
+
+  return 1;
+}
+
+//Returns 1 if the directory at location is part of a snapshot, which
+//makes it read-only
+int inSnapshot(int location) {
+  int snapshots = snapshotsLocation();
+  return snapshots && isWithin(location, snapshots);
+}
+
+//Frees the clusters of every file in the directory at location and the
+//directories under it, and then the directory itself
+void releaseDir(int location) {
+  hashTable* dir = readTableData(location);
+
+  for (int i = 0; i < SIZE; i++) {
+    for (node* n = dir->entries[i]; n != NULL; n = n->next) {
+      dirEntry* entry = n->value;
+      if (strcmp(entry->filename, "") == 0 ||
+        strcmp(entry->filename, ".") == 0 ||
+        strcmp(entry->filename, "..") == 0) {
+        continue;
+      }
+
+      if (entry->isDir) {
+        releaseDir(entry->location);
+      } else {
+        blockMap* map = mapLoadEntry(entry);
+        mapRelease(map);
+        mapFree(map);
+        map = NULL;
+      }
+    }
+  }
+
+  clean(dir);
+  dir = NULL;
+
+  setBlocksAsFree(location, DIR_SIZE);
+}
+
+//Copies the entries of the directory at srcLocation into the empty
+//directory at destLocation, skipping the directory at skip. Files share
+//their clusters with the originals and directories are copied the same
+//way. Returns 0 on success and -1 if the volume is full.
+int copyDir(int srcLocation, int destLocation, int skip) {
+  hashTable* src = readTableData(srcLocation);
+  hashTable* dest = readTableData(destLocation);
+  int result = 0;
+
+  for (int i = 0; i < SIZE && result == 0; i++) {
+    for (node* n = src->entries[i]; n != NULL && result == 0; n = n->next) {
+      dirEntry* entry = n->value;
+      if (strcmp(entry->filename, "") == 0 ||
+        strcmp(entry->filename, ".") == 0 ||
+        strcmp(entry->filename, "..") == 0 ||
+        (entry->isDir && entry->location == skip)) {
+        continue;
+      }
+
+      if (entry->isDir) {
+        int location = createDir(dest, entry->filename);
+        if (location < 0 || copyDir(entry->location, location, skip) < 0) {
+          result = -1;
+          break;
+        }
+
+        dirEntry* copy = getEntry(entry->filename, dest);
+        copy->dateModified = entry->dateModified;
+        copy->dateCreated = entry->dateCreated;
+        continue;
+      }
+
+      //A file's copy gets a map of its own that shares every cluster,
+      //while inline data is copied along with the entry
+      dirEntry copy;
+      memcpy(&copy, entry, sizeof(dirEntry));
+      if (entry->location) {
+        blockMap* map = mapLoadEntry(entry);
+        blockMap* shared = shareMap(map);
+        mapFree(map);
+        map = NULL;
+        if (!shared) {
+          result = -1;
+          break;
+        }
+
+        copy.location = mapSave(shared);
+        copy.tailMap = mapTail(shared);
+        mapFree(shared);
+        shared = NULL;
+      }
+
+      if (!setEntry(copy.filename, &copy, dest)) {
+        result = -1;
+      }
+    }
+  }
+
+  clean(src);
+  src = NULL;
+  writeTableData(dest, destLocation);
+  dest = NULL;
+
+  return result;
+}
+
+//Takes a snapshot of the whole volume called name, readable through
+///.snapshots/name
+int fs_snapshot(char* name) {
+  if (!refsEnabled()) {
+    printf("Error: this volume cannot share blocks between files\n");
+    return -1;
+  }
+
+  if (strlen(name) == 0 || strlen(name) >= DIR_NAME_SIZE ||
+    strchr(name, '/') || strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+    printf("Error: %s is not a valid snapshot name\n", name);
+    return -1;
+  }
+
+  //Changes still in the buffers of open files belong in the snapshot
+  b_sync();
+
+  int snapshots = snapshotsLocation();
+  if (!snapshots) {
+    hashTable* root = getDir("/");
+    int rootLocation = root->location;
+    snapshots = createDir(root, SNAPSHOT_DIR);
+    if (snapshots < 0) {
+      clean(root);
+      root = NULL;
+      writeFreeSpace();
+      return -1;
+    }
+    writeTableData(root, rootLocation);
+    root = NULL;
+  }
+
+  hashTable* dir = readTableData(snapshots);
+  if (getEntry(name, dir)) {
+    printf("Error: a snapshot called %s already exists\n", name);
+    clean(dir);
+    dir = NULL;
+    return -1;
+  }
+
+  int location = createDir(dir, name);
+  if (location < 0) {
+    clean(dir);
+    dir = NULL;
+    writeFreeSpace();
+    return -1;
+  }
+  writeTableData(dir, snapshots);
+  dir = NULL;
+
+  hashTable* root = getDir("/");
+  int rootLocation = root->location;
+  clean(root);
+  root = NULL;
+
+  //A snapshot that does not fit is removed again
+  if (copyDir(rootLocation, location, snapshots) < 0) {
+    printf("Error: there is not enough space for snapshot %s\n", name);
+    writeFreeSpace();
+    fs_rmsnapshot(name);
+    return -1;
+  }
+
+  writeFreeSpace();
+  return 0;
+}
+
+//Removes the snapshot called name, freeing the clusters that only it uses
+int fs_rmsnapshot(char* name) {
+  int snapshots = snapshotsLocation();
+  if (!snapshots) {
+    printf("Error: there is no snapshot called %s\n", name);
+    return -1;
+  }
+
+  hashTable* dir = readTableData(snapshots);
+  dirEntry* entry = getEntry(name, dir);
+  if (!entry) {
+    printf("Error: there is no snapshot called %s\n", name);
+    clean(dir);
+    dir = NULL;
+    return -1;
+  }
+
+  if (isWithin(workingDir->location, entry->location)) {
+    printf("Error: cannot remove snapshot %s while inside it\n", name);
+    clean(dir);
+    dir = NULL;
+    return -1;
+  }
+
+  releaseDir(entry->location);
+  rmEntry(name, dir);
+  writeTableData(dir, snapshots);
+  dir = NULL;
+
+  writeFreeSpace();
+  return 0;
+}
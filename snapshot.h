@@ -0,0 +1,44 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: snapshot.h
+*
+* Description: This file holds the prototypes of the functions that
+* take read-only snapshots of the volume. A snapshot is a copy of the
+* directory tree under /.snapshots/<name> whose files share their
+* clusters with the live files, so taking one copies no file data and
+* a cluster is only copied when a live file first writes to it.
+*
+**************************************************************/
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "fs_commands.h"
+
+//Name of the directory in root that holds the snapshots
+#define SNAPSHOT_DIR ".snapshots"
+
+//Returns the location of the directory that holds the snapshots (0 if
+//no snapshot has been taken)
+int snapshotsLocation();
+
+//Returns 1 if the directory at location is ancestor or is inside it
+int isWithin(int location, int ancestor);
+
+//Returns 1 if the directory at location is part of a snapshot, which
+//makes it read-only
+int inSnapshot(int location);
+
+//Takes a snapshot of the whole volume called name, readable through
+///.snapshots/name
+int fs_snapshot(char* name);
+
+//Removes the snapshot called name, freeing the clusters that only it uses
+int fs_rmsnapshot(char* name);
+
+#endif
@@ -0,0 +1,259 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: tier.c
+*
+* Description: This file holds the tier mover of a volume made up of a
+* fast and a slow volume file. The heat of each cluster is kept in
+* memory only, so a volume that was just mounted starts out cold.
+*
+**************************************************************/
+
+#include "tier.h"
+#include "b_io.h"
+#include "checksum.h"
+#include "segment.h"
+#include "relocate.h"
+
+unsigned char* heat = NULL;   //Heat of each cluster (NULL = not tiered)
+int heatClusters = 0;         //Number of clusters heat has entries for
+int moverPasses = 0;          //Passes of the mover since heats were halved
+
+//Sets up the heat of the numClusters clusters of a mounted volume
+void tierInit(int numClusters) {
+  free(heat);
+  heat = NULL;
+  heatClusters = 0;
+
+  if (!deviceFastBlocks()) {
+    return;
+  }
+
+  heat = calloc(numClusters, 1);
+  if (!heat) {
+    mallocFailed();
+  }
+  heatClusters = numClusters;
+}
+
+//Records that count blocks starting at block were read or written
+void tierTouch(uint64_t block, uint64_t count) {
+  if (!heat || count == 0) {
+    return;
+  }
+
+  uint64_t last = (block + count - 1) / clusterBlocks;
+  for (uint64_t cluster = block / clusterBlocks;
+    cluster <= last && cluster < heatClusters; cluster++) {
+    if (heat[cluster] < 255) {
+      heat[cluster]++;
+    }
+  }
+}
+
+//Picks up to want clusters of file data from cluster first up to last,
+//the hottest ones at or above TIER_HOT if hottest is 1 and otherwise the
+//coldest ones below it, storing them in clusters and returning how many
+//were picked
+int pickClusters(ownerMap* owners, int first, int last, int hottest,
+  int want, int* clusters) {
+  //The number of clusters at each heat tells the heat the picked
+  //clusters go down (or up) to
+  int atHeat[256] = { 0 };
+  for (int c = first; c < last; c++) {
+    if (owners->owner[c] >= 0) {
+      atHeat[heat[c]]++;
+    }
+  }
+
+  int cutoff = hottest ? 255 : 0;
+  int found = 0;
+  while (1) {
+    int usable = hottest ? cutoff >= TIER_HOT : cutoff < TIER_HOT;
+    if (!usable) {
+      cutoff += hottest ? 1 : -1;   //every usable cluster is picked
+      break;
+    }
+    found += atHeat[cutoff];
+    if (found >= want) {
+      break;
+    }
+    cutoff += hottest ? -1 : 1;
+  }
+
+  //Clusters past the cutoff are all picked, and then those at it
+  int picked = 0;
+  for (int pass = 0; pass < 2 && picked < want; pass++) {
+    for (int c = first; c < last && picked < want; c++) {
+      if (owners->owner[c] < 0) {
+        continue;
+      }
+      int beyond = hottest ? heat[c] > cutoff : heat[c] < cutoff;
+      if ((pass == 0 && beyond) || (pass == 1 && heat[c] == cutoff)) {
+        clusters[picked++] = c;
+      }
+    }
+  }
+
+  return picked;
+}
+
+//Copies the count clusters in clusters to free clusters from cluster first
+//up to last, then points their files at the copies, returning the number
+//of clusters moved
+int moveToTier(ownerMap* owners, int* clusters, int count, int first,
+  int last) {
+  char* data = malloc((size_t)count * clusterSize);
+  int* newBlocks = calloc(count, sizeof(int));
+  if (!data || !newBlocks) {
+    mallocFailed();
+  }
+
+  int next = first;
+  int placed = 0;
+  while (placed < count) {
+    while (next < last && !clusterIsFree(next)) {
+      next++;
+    }
+    if (next >= last) {
+      break;    //the tier is full
+    }
+
+    int oldBlock = clusters[placed] * clusterBlocks;
+    int newBlock = next * clusterBlocks;
+    setBlocksAsAllocated(newBlock, clusterBlocks);
+    next++;
+
+    //The cluster keeps its heat in its new place, without the heat of
+    //the copy itself
+    unsigned char clusterHeat = heat[clusters[placed]];
+    char* clusterData = data + (size_t)placed * clusterSize;
+    segmentRead(clusterData, clusterBlocks, oldBlock);
+    deviceWrite(clusterData, clusterBlocks, newBlock);
+    copyChecksums(oldBlock, newBlock, 1);
+    heat[newBlock / clusterBlocks] = clusterHeat;
+    heat[clusters[placed]] = 0;
+
+    newBlocks[placed] = newBlock;
+    placed++;
+  }
+
+  int moved = relocateClusters(owners, clusters, newBlocks, placed, data);
+
+  free(data);
+  data = NULL;
+  free(newBlocks);
+  newBlocks = NULL;
+
+  return moved;
+}
+
+//Runs one pass of the tier mover, storing the number of clusters moved
+//to each tier in promoted and demoted, and returns the number moved
+int tierMove(int* promoted, int* demoted) {
+  *promoted = 0;
+  *demoted = 0;
+  if (!heat) {
+    return 0;
+  }
+
+  //Clusters are moved between the tiers, so nothing can read them
+  //meanwhile
+  lockVolume(1);
+
+  //File data only goes in the fast tier up to the clusters kept for
+  //metadata
+  int dataClusters;
+  int fastClusters;
+  metadataReserve(&dataClusters, &fastClusters);
+  int reserve = dataClusters / TIER_FAST_RESERVE;
+
+  int freeFast = 0;
+  for (int c = 0; c < dataClusters; c++) {
+    freeFast += clusterIsFree(c);
+  }
+
+  int hotSlow = 0;
+  for (int c = fastClusters; c < heatClusters && !hotSlow; c++) {
+    hotSlow = heat[c] >= TIER_HOT && !clusterIsFree(c);
+  }
+
+  //Finding the owner of every cluster means reading every directory and
+  //block map, so it is only done when there is something to move
+  if (freeFast < reserve || hotSlow) {
+    ownerMap* owners = ownerMapBuild();
+    int* hotClusters = malloc(TIER_MOVE_MAX / 2 * sizeof(int));
+    int* coldClusters = malloc(TIER_MOVE_MAX / 2 * sizeof(int));
+    if (!hotClusters || !coldClusters) {
+      mallocFailed();
+    }
+
+    int numHot = 0;
+    if (hotSlow) {
+      numHot = pickClusters(owners, fastClusters, heatClusters, 1,
+        TIER_MOVE_MAX / 2, hotClusters);
+    }
+
+    //Cold clusters make way for the reserve and the hot clusters
+    int want = reserve - freeFast + numHot;
+    if (want > TIER_MOVE_MAX / 2) {
+      want = TIER_MOVE_MAX / 2;
+    }
+    if (want > 0) {
+      int numCold = pickClusters(owners, 0, dataClusters, 0, want,
+        coldClusters);
+      *demoted = moveToTier(owners, coldClusters, numCold, fastClusters,
+        heatClusters);
+      freeFast += *demoted;
+    }
+
+    if (numHot > freeFast - reserve) {
+      numHot = freeFast - reserve;
+    }
+    if (numHot > 0) {
+      *promoted = moveToTier(owners, hotClusters, numHot, 0, dataClusters);
+    }
+
+    free(hotClusters);
+    hotClusters = NULL;
+    free(coldClusters);
+    coldClusters = NULL;
+    ownerMapFree(owners);
+    owners = NULL;
+  }
+
+  //Heat fades so that only clusters used recently count as hot
+  if (++moverPasses >= TIER_DECAY_PASSES) {
+    for (int c = 0; c < heatClusters; c++) {
+      heat[c] /= 2;
+    }
+    moverPasses = 0;
+  }
+
+  unlockVolume();
+
+  return *promoted + *demoted;
+}
+
+//Runs a pass of the tier mover on a tiered volume and prints what it
+//moved, returning the number of clusters moved or -1 if the volume is
+//not tiered
+int fs_tier() {
+  if (!heat) {
+    printf("Error: the volume is not tiered\n");
+    return -1;
+  }
+
+  int promoted;
+  int demoted;
+  int moved = tierMove(&promoted, &demoted);
+  printf("Promoted %d clusters to the fast tier, demoted %d to the slow "
+    "tier\n", promoted, demoted);
+
+  return moved;
+}
@@ -0,0 +1,50 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: tier.h
+*
+* Description: This file holds the prototypes of the tier mover of a
+* volume made up of a fast and a slow volume file. Every cluster has
+* a heat that goes up each time it is read or written and is halved
+* every few passes of the mover. The mover promotes hot clusters of
+* file data to the fast tier and demotes the coldest ones to the slow
+* tier to keep room free on the fast tier. Metadata is never moved.
+* It is given the clusters at the end of the fast tier that file data
+* is kept out of (see METADATA_RESERVE), so it stays on the fast tier
+* when file data fills the rest of it.
+*
+**************************************************************/
+#ifndef TIER_H
+#define TIER_H
+
+#include "fs_commands.h"
+
+#define TIER_HOT 2            //Heat at which a cluster is promoted
+#define TIER_DECAY_PASSES 4   //Passes of the mover between halving heats
+#define TIER_MOVE_MAX 256     //Most clusters one pass of the mover moves
+
+//The part of the fast tier file data can use is kept with 1 in
+//TIER_FAST_RESERVE of its clusters free, so that new data has room on it
+#define TIER_FAST_RESERVE 8
+
+//Sets up the heat of the numClusters clusters of a mounted volume
+void tierInit(int numClusters);
+
+//Records that count blocks starting at block were read or written
+void tierTouch(uint64_t block, uint64_t count);
+
+//Runs one pass of the tier mover, storing the number of clusters moved
+//to each tier in promoted and demoted, and returns the number moved
+int tierMove(int* promoted, int* demoted);
+
+//Runs a pass of the tier mover on a tiered volume and prints what it
+//moved, returning the number of clusters moved or -1 if the volume is
+//not tiered
+int fs_tier();
+
+#endif
@@ -0,0 +1,144 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: xor.c
+*
+* Description: This file holds the XOR used to compute the parity of
+* a striped volume. Each version XORs as many bytes at a time as its
+* registers hold, and the bytes left over 8 or 1 at a time.
+*
+**************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include "xor.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+//The function xorBlocks() uses, picked by xorInit()
+size_t (*xorUpdate)(unsigned char* dest, const unsigned char* src,
+  size_t len) = NULL;
+
+//XORs the bytes of src into dest 8 at a time, returning the number of
+//bytes done
+size_t xorUpdateWords(unsigned char* dest, const unsigned char* src,
+  size_t len) {
+  size_t done = 0;
+  while (len - done >= 8) {
+    uint64_t a;
+    uint64_t b;
+    memcpy(&a, dest + done, sizeof(a));
+    memcpy(&b, src + done, sizeof(b));
+    a ^= b;
+    memcpy(dest + done, &a, sizeof(a));
+    done += 8;
+  }
+  return done;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+//XORs the bytes of src into dest 16 at a time with SSE2, returning the
+//number of bytes done
+__attribute__((target("sse2")))
+size_t xorUpdateSse2(unsigned char* dest, const unsigned char* src,
+  size_t len) {
+  size_t done = 0;
+  while (len - done >= 64) {
+    for (int i = 0; i < 64; i += 16) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(dest + done + i));
+      __m128i b = _mm_loadu_si128((const __m128i*)(src + done + i));
+      _mm_storeu_si128((__m128i*)(dest + done + i), _mm_xor_si128(a, b));
+    }
+    done += 64;
+  }
+  while (len - done >= 16) {
+    __m128i a = _mm_loadu_si128((const __m128i*)(dest + done));
+    __m128i b = _mm_loadu_si128((const __m128i*)(src + done));
+    _mm_storeu_si128((__m128i*)(dest + done), _mm_xor_si128(a, b));
+    done += 16;
+  }
+  return done;
+}
+
+//XORs the bytes of src into dest 32 at a time with AVX2, returning the
+//number of bytes done
+__attribute__((target("avx2")))
+size_t xorUpdateAvx2(unsigned char* dest, const unsigned char* src,
+  size_t len) {
+  size_t done = 0;
+  while (len - done >= 128) {
+    for (int i = 0; i < 128; i += 32) {
+      __m256i a = _mm256_loadu_si256((const __m256i*)(dest + done + i));
+      __m256i b = _mm256_loadu_si256((const __m256i*)(src + done + i));
+      _mm256_storeu_si256((__m256i*)(dest + done + i),
+        _mm256_xor_si256(a, b));
+    }
+    done += 128;
+  }
+  while (len - done >= 32) {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(dest + done));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(src + done));
+    _mm256_storeu_si256((__m256i*)(dest + done), _mm256_xor_si256(a, b));
+    done += 32;
+  }
+  return done;
+}
+#elif defined(__aarch64__)
+//XORs the bytes of src into dest 16 at a time with NEON, returning the
+//number of bytes done
+size_t xorUpdateNeon(unsigned char* dest, const unsigned char* src,
+  size_t len) {
+  size_t done = 0;
+  while (len - done >= 16) {
+    uint8x16_t a = vld1q_u8(dest + done);
+    uint8x16_t b = vld1q_u8(src + done);
+    vst1q_u8(dest + done, veorq_u8(a, b));
+    done += 16;
+  }
+  return done;
+}
+#endif
+
+//Picks the fastest way to XOR on this processor. It must be called
+//before xorBlocks() is used by more than one thread.
+void xorInit() {
+  if (xorUpdate) {
+    return;
+  }
+
+  xorUpdate = xorUpdateWords;
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_supports("avx2")) {
+    xorUpdate = xorUpdateAvx2;
+  } else if (__builtin_cpu_supports("sse2")) {
+    xorUpdate = xorUpdateSse2;
+  }
+#elif defined(__aarch64__)
+  xorUpdate = xorUpdateNeon;
+#endif
+}
+
+//XORs len bytes of src into dest
+void xorBlocks(void* dest, const void* src, size_t len) {
+  if (!xorUpdate) {
+    xorInit();
+  }
+
+  unsigned char* d = dest;
+  const unsigned char* s = src;
+  size_t done = xorUpdate(d, s, len);
+  done += xorUpdateWords(d + done, s + done, len - done);
+  while (done < len) {
+    d[done] ^= s[done];
+    done++;
+  }
+}
@@ -0,0 +1,29 @@
+/**************************************************************
+* Class: CSC-415-02 Spring 2022
+* Names: Patrick Celedio, Chase Alexander, Gurinder Singh, Jonathan Luu
+* Student IDs: 920457223, 921040156, 921369355, 918548844
+* GitHub Name: csc415-filesystem-CalDevC
+* Group Name: Sudoers
+* Project: Basic File System
+*
+* File: xor.h
+*
+* Description: This file holds the prototypes of the XOR used to
+* compute the parity of a striped volume. The SIMD instructions of
+* AVX2, SSE2, or NEON are used when the processor has them, otherwise
+* the XOR is done 8 bytes at a time.
+*
+**************************************************************/
+#ifndef XOR_H
+#define XOR_H
+
+#include <stddef.h>
+
+//Picks the fastest way to XOR on this processor. It must be called
+//before xorBlocks() is used by more than one thread.
+void xorInit();
+
+//XORs len bytes of src into dest
+void xorBlocks(void* dest, const void* src, size_t len);
+
+#endif